@@ -19,6 +19,33 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+static thread_local arena_t scratch_arenas[ARENA_SCRATCH_COUNT];
+
+#if ARENA_STATS
+    #define ARENA_STATS_RECORD_ALLOC(arena, sz, padding) ARENA_StatsRecordAlloc(arena, sz, padding)
+    #define ARENA_STATS_INCREMENT(arena, field, amount)  ((arena)->stats.field += (amount))
+    #define ARENA_STATS_UPDATE_PEAK(arena) \
+        do { \
+            if ((arena)->curr_offset > (arena)->stats.peak_bytes) (arena)->stats.peak_bytes = (arena)->curr_offset; \
+        } while (0)
+
+void ARENA_StatsRecordAlloc(arena_t* arena, size sz, size padding)
+{
+    uint bucket = sz == 0 ? 0 : 64 - __builtin_clzll(cast(uint64) sz);
+    if (bucket >= ARENA_STATS_BUCKETS) bucket = ARENA_STATS_BUCKETS-1;
+
+    arena->stats.alloc_count += 1;
+    arena->stats.alloc_bytes += sz;
+    arena->stats.padding_bytes += padding;
+    arena->stats.histogram[bucket] += 1;
+    ARENA_STATS_UPDATE_PEAK(arena);
+}
+#else
+    #define ARENA_STATS_RECORD_ALLOC(arena, sz, padding)
+    #define ARENA_STATS_INCREMENT(arena, field, amount)
+    #define ARENA_STATS_UPDATE_PEAK(arena) do { } while (0)
+#endif
+
 bool ptr_is_power_of_two(uintptr x)
 {
     return (x & (x-1)) == 0;
@@ -30,6 +57,72 @@ void ARENA_Initialize(arena_t* arena, void* buffer, size buffer_length)
     arena->buf_len = buffer_length;
     arena->curr_offset = 0;
     arena->prev_offset = 0;
+    arena->reserve_len = 0;
+
+#if ARENA_STATS
+    memset(&arena->stats, 0, sizeof(arena->stats));
+#endif
+}
+
+bool ARENA_InitializeVirtual(arena_t* arena, size reserve_length)
+{
+    // @FIXME: This does not compile on Windows (VirtualAlloc with MEM_RESERVE).
+    reserve_length = ARENA_AlignForward(reserve_length, ARENA_COMMIT_GRANULARITY);
+    void* buffer = mmap(0, reserve_length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (buffer == MAP_FAILED) {
+        return false;
+    }
+
+    ARENA_Initialize(arena, buffer, 0);
+    arena->reserve_len = reserve_length;
+    return true;
+}
+
+// For arenas of unknown size: reserves ARENA_DEFAULT_RESERVE, or as much of it
+// as the address space allows.
+bool ARENA_InitializeDefault(arena_t* arena)
+{
+    size reserve_length = ARENA_DEFAULT_RESERVE;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+        && limit.rlim_cur / ARENA_RESERVE_SHARE < reserve_length) {
+        reserve_length = limit.rlim_cur / ARENA_RESERVE_SHARE;
+    }
+
+    while (!ARENA_InitializeVirtual(arena, reserve_length)) {
+        if (reserve_length <= ARENA_MIN_RESERVE) return false;
+        reserve_length /= 2;
+        if (reserve_length < ARENA_MIN_RESERVE) reserve_length = ARENA_MIN_RESERVE;
+    }
+    return true;
+}
+
+// For arenas nothing can go on without, when there is no caller to hand the
+// error to.
+void ARENA_ExitOutOfMemory(void)
+{
+    fprintf(stderr, "error: ran out of memory.\n");
+    exit(1);
+}
+
+bool ARENA_Commit(arena_t* arena, size length)
+{
+    if (length <= arena->buf_len) return true;
+    if (length > arena->reserve_len) return false;
+
+    // Grow the committed region geometrically so that big inputs only take a
+    // handful of mprotect() calls. Untouched pages still cost no memory.
+    size new_len = ARENA_AlignForward(length, ARENA_COMMIT_GRANULARITY);
+    if (new_len < arena->buf_len*2) new_len = arena->buf_len*2;
+    if (new_len > arena->reserve_len) new_len = arena->reserve_len;
+
+    if (mprotect(arena->buf + arena->buf_len, new_len - arena->buf_len, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+
+    arena->buf_len = new_len;
+    ARENA_STATS_INCREMENT(arena, commit_count, 1);
+    return true;
 }
 
 void ARENA_Free(arena_t* arena)
@@ -38,6 +131,18 @@ void ARENA_Free(arena_t* arena)
     arena->prev_offset = 0;
 }
 
+void ARENA_Release(arena_t* arena)
+{
+    if (arena->reserve_len != 0) {
+        munmap(arena->buf, arena->reserve_len);
+        arena->buf = null;
+        arena->buf_len = 0;
+        arena->reserve_len = 0;
+    }
+
+    ARENA_Free(arena);
+}
+
 uintptr ARENA_AlignForward(uintptr ptr, size align)
 {
     // @TODO: debug_assert(ptr_is_power_of_two(align));
@@ -52,23 +157,36 @@ uintptr ARENA_AlignForward(uintptr ptr, size align)
     return p;
 }
 
-void* ARENA_AllocAligned(arena_t* arena, size sz, size align)
+// Same as ARENA_AllocAligned(), but leaves whatever was in memory before.
+// Only use it when the caller is going to overwrite all of it right away.
+void* ARENA_AllocAlignedNoZero(arena_t* arena, size sz, size align)
 {
     uintptr curr_ptr = cast(uintptr) arena->buf + cast(uintptr) arena->curr_offset;
     uintptr offset = ARENA_AlignForward(curr_ptr, align);
     offset -= cast(uintptr) arena->buf;
 
-    // Check for space left
-    if (offset + sz <= arena->buf_len) {
-        void* ptr = &arena->buf[offset];
-        arena->prev_offset = offset;
-        arena->curr_offset = offset+sz;
-
-        memset(ptr, 0, sz);
-        return ptr;
+    // Check for space left, committing more pages for virtual arenas.
+    if (offset + sz > arena->buf_len && !ARENA_Commit(arena, offset + sz)) {
+        return null;
     }
 
-    return null;
+    void* ptr = &arena->buf[offset];
+    arena->prev_offset = offset;
+    arena->curr_offset = offset+sz;
+    ARENA_STATS_RECORD_ALLOC(arena, sz, offset - (curr_ptr - cast(uintptr) arena->buf));
+    return ptr;
+}
+
+void* ARENA_AllocAligned(arena_t* arena, size sz, size align)
+{
+    void* ptr = ARENA_AllocAlignedNoZero(arena, sz, align);
+    if (ptr != null) memset(ptr, 0, sz);
+    return ptr;
+}
+
+void* ARENA_AllocNoZero(arena_t* arena, size sz)
+{
+    return ARENA_AllocAlignedNoZero(arena, sz, DEFAULT_ARENA_ALIGNMENT);
 }
 
 void* ARENA_Alloc(arena_t* arena, size sz)
@@ -76,29 +194,40 @@ void* ARENA_Alloc(arena_t* arena, size sz)
     return ARENA_AllocAligned(arena, sz, DEFAULT_ARENA_ALIGNMENT);
 }
 
-void* ARENA_ResizeAligned(arena_t* arena, void* old_memory, size old_sz, size new_sz, size align) {
+// Like ARENA_ResizeAligned(), but whatever the memory grew by is left as is.
+void* ARENA_ResizeAlignedNoZero(arena_t* arena, void* old_memory, size old_sz, size new_sz, size align) {
     // @TODO: debug_assert(ptr_is_power_of_two(align));
     byte* old_mem = cast(byte*) old_memory;
 
     if (old_mem == null || old_sz == 0) {
-        return ARENA_AllocAligned(arena, new_sz, align);
+        return ARENA_AllocAlignedNoZero(arena, new_sz, align);
     } else if (arena->buf <= old_mem && old_mem < arena->buf + arena->buf_len) {
         if (arena->buf + arena->prev_offset == old_mem) {
-            arena->curr_offset = arena->prev_offset + new_sz;
+            if (arena->prev_offset + new_sz > arena->buf_len
+                && !ARENA_Commit(arena, arena->prev_offset + new_sz)) {
+                return null;
+            }
 
-            if (new_sz > old_sz)
-                memset(&arena->buf[arena->curr_offset], 0, new_sz-old_sz);
+            arena->curr_offset = arena->prev_offset + new_sz;
+            ARENA_STATS_INCREMENT(arena, resize_in_place_count, 1);
+            ARENA_STATS_UPDATE_PEAK(arena);
 
             return old_memory;
         } else {
-            void* new_memory = ARENA_AllocAligned(arena, new_sz, align);
+            byte* new_memory = ARENA_AllocAlignedNoZero(arena, new_sz, align);
+            if (new_memory == null) return null;
+
             size_t copy_sz = 0;
             if (old_sz < new_sz)
                 copy_sz = old_sz;
             else
                 copy_sz = new_sz;
 
-            memmove(new_memory, old_memory, copy_sz);
+            ARENA_STATS_INCREMENT(arena, resize_copy_count, 1);
+            ARENA_STATS_INCREMENT(arena, resize_copy_bytes, copy_sz);
+
+            // The new block always comes after the old one, so they can't overlap.
+            memcpy(new_memory, old_memory, copy_sz);
             return new_memory;
         }
     } else {
@@ -108,6 +237,118 @@ void* ARENA_ResizeAligned(arena_t* arena, void* old_memory, size old_sz, size ne
     }
 }
 
+void* ARENA_ResizeAligned(arena_t* arena, void* old_memory, size old_sz, size new_sz, size align) {
+    byte* new_memory = ARENA_ResizeAlignedNoZero(arena, old_memory, old_sz, new_sz, align);
+    if (new_memory == null) return null;
+
+    if (old_memory == null) old_sz = 0;
+    if (new_sz > old_sz)
+        memset(new_memory + old_sz, 0, new_sz - old_sz);
+
+    return new_memory;
+}
+
 void* ARENA_Resize(arena_t* arena, void* old_memory, size old_sz, size new_sz) {
     return ARENA_ResizeAligned(arena, old_memory, old_sz, new_sz, DEFAULT_ARENA_ALIGNMENT);
 }
+
+arena_temp_t ARENA_TempBegin(arena_t* arena)
+{
+    arena_temp_t temp;
+    temp.arena = arena;
+    temp.prev_offset = arena->prev_offset;
+    temp.curr_offset = arena->curr_offset;
+    return temp;
+}
+
+void ARENA_TempEnd(arena_temp_t temp)
+{
+    temp.arena->prev_offset = temp.prev_offset;
+    temp.arena->curr_offset = temp.curr_offset;
+}
+
+arena_temp_t ARENA_GetScratch(arena_t** conflicts, uint conflicts_len)
+{
+    // Scratch arenas as described in:
+    // * https://www.rfleury.com/p/untangling-lifetimes-the-arena-allocator
+    // Pick the first scratch arena that the caller is not already using, so
+    // that nested scratch allocations never stomp on each other.
+    for (uint i = 0; i < ARENA_SCRATCH_COUNT; ++i) {
+        arena_t* scratch = &scratch_arenas[i];
+
+        bool has_conflict = false;
+        for (uint j = 0; j < conflicts_len; ++j) {
+            if (conflicts[j] == scratch) {
+                has_conflict = true;
+                break;
+            }
+        }
+
+        if (has_conflict) continue;
+
+        if (scratch->buf == null && !ARENA_InitializeDefault(scratch)) {
+            ARENA_ExitOutOfMemory();
+        }
+
+        return ARENA_TempBegin(scratch);
+    }
+
+    // @TODO: debug_assert, we ran out of scratch arenas.
+    assert(false);
+    return ARENA_TempBegin(null);
+}
+
+void ARENA_ReleaseScratch(arena_temp_t scratch)
+{
+    ARENA_TempEnd(scratch);
+}
+
+// Scratch arenas belong to the thread that first used them. Threads that are
+// about to exit give theirs back here, or they would never be unmapped.
+void ARENA_ReleaseThreadScratch(void)
+{
+    for (uint i = 0; i < ARENA_SCRATCH_COUNT; ++i) {
+        ARENA_Release(&scratch_arenas[i]);
+    }
+}
+
+void ARENA_DumpStats(arena_t* arena, const char* name)
+{
+#if ARENA_STATS
+    arena_stats_t* stats = &arena->stats;
+    fprintf(stderr, "arena '%s':\n", name);
+    fprintf(stderr, "    peak bytes:      %zu\n", stats->peak_bytes);
+    fprintf(stderr, "    committed bytes: %zu (%zu commits)\n", arena->buf_len, stats->commit_count);
+    fprintf(stderr, "    allocations:     %zu (%zu bytes)\n", stats->alloc_count, stats->alloc_bytes);
+    fprintf(stderr, "    padding bytes:   %zu\n", stats->padding_bytes);
+    fprintf(stderr, "    resizes:         %zu in place, %zu copied (%zu bytes)\n",
+            stats->resize_in_place_count, stats->resize_copy_count, stats->resize_copy_bytes);
+
+    if (stats->alloc_count == 0) return;
+
+    fprintf(stderr, "    size histogram:\n");
+    for (uint i = 0; i < ARENA_STATS_BUCKETS; ++i) {
+        if (stats->histogram[i] == 0) continue;
+
+        size upper = cast(size) 1 << i;
+        if (i == ARENA_STATS_BUCKETS-1) {
+            fprintf(stderr, "        >= %-9zu %zu\n", upper >> 1, stats->histogram[i]);
+        } else {
+            fprintf(stderr, "        <  %-9zu %zu\n", upper, stats->histogram[i]);
+        }
+    }
+#else
+    fprintf(stderr, "arena '%s': stats not available, build with -DARENA_STATS=1.\n", name);
+#endif
+}
+
+void ARENA_DumpScratchStats(void)
+{
+    for (uint i = 0; i < ARENA_SCRATCH_COUNT; ++i) {
+        if (scratch_arenas[i].buf == null) continue;
+
+        char name[] = "scratch #0";
+        name[lengthof(name)-1] += i;
+        ARENA_DumpStats(&scratch_arenas[i], name);
+    }
+}
@@ -27,24 +27,98 @@
 
 #define DEFAULT_ARENA_ALIGNMENT (2*sizeof(void*))
 
+// Virtual arenas reserve this much address space up front and commit pages as
+// they are needed, so allocations never move and the reservation is mostly free.
+#define ARENA_DEFAULT_RESERVE     (cast(size) 64 << 30)
+#define ARENA_COMMIT_GRANULARITY  (cast(size) 64 << 10)
+
+// Under a limited address space (ulimit -v), ARENA_InitializeDefault() takes
+// at most 1/ARENA_RESERVE_SHARE of it per arena, and halves that down to
+// ARENA_MIN_RESERVE for as long as it does not fit.
+#define ARENA_RESERVE_SHARE       64
+#define ARENA_MIN_RESERVE         (cast(size) 1 << 20)
+
+// Per-arena counters. Build with -DARENA_STATS=1 to enable them, otherwise
+// they are compiled out entirely and cost nothing.
+#ifndef ARENA_STATS
+    #define ARENA_STATS 0
+#endif
+
+// Allocation sizes are bucketed by powers of two: bucket N counts the
+// allocations in [2^(N-1), 2^N). The last bucket also takes everything bigger.
+#define ARENA_STATS_BUCKETS 20
+
+struct arena_stats
+{
+    size peak_bytes;
+    size alloc_count;
+    size alloc_bytes;
+    size padding_bytes;
+    size commit_count;
+    size resize_in_place_count;
+    size resize_copy_count;
+    size resize_copy_bytes;
+    size histogram[ARENA_STATS_BUCKETS];
+};
+typedef struct arena_stats arena_stats_t;
+
 struct arena
 {
     byte* buf;
-    size buf_len;
+    size buf_len; // Committed (usable) bytes.
     size prev_offset;
     size curr_offset;
+
+    // Only set for virtual arenas, zero for arenas over a fixed buffer.
+    size reserve_len;
+
+#if ARENA_STATS
+    arena_stats_t stats;
+#endif
 };
 typedef struct arena arena_t;
 
+// Saved position of an arena. Everything allocated after ARENA_TempBegin() is
+// thrown away by the matching ARENA_TempEnd().
+struct arena_temp
+{
+    arena_t* arena;
+    size prev_offset;
+    size curr_offset;
+};
+typedef struct arena_temp arena_temp_t;
+
+// Number of scratch arenas per thread. Two is enough as long as a function
+// only ever conflicts with the scratch arena its caller handed it.
+#define ARENA_SCRATCH_COUNT 2
+
 bool ptr_is_power_of_two(uintptr x);
 
 void ARENA_Initialize(arena_t* arena, void* buffer, size buffer_length);
+bool ARENA_InitializeVirtual(arena_t* arena, size reserve_length);
+bool ARENA_InitializeDefault(arena_t* arena);
+void ARENA_ExitOutOfMemory(void);
+bool ARENA_Commit(arena_t* arena, size length);
 void ARENA_Free(arena_t* arena);
+void ARENA_Release(arena_t* arena);
 
 uintptr ARENA_AlignForward(uintptr ptr, size align);
+void* ARENA_AllocAlignedNoZero(arena_t* arena, size sz, size align);
 void* ARENA_AllocAligned(arena_t* arena, size sz, size align);
+void* ARENA_AllocNoZero(arena_t* arena, size sz);
 void* ARENA_Alloc(arena_t* arena, size sz);
+void* ARENA_ResizeAlignedNoZero(arena_t* arena, void* old_memory, size old_sz, size new_sz, size align);
 void* ARENA_ResizeAligned(arena_t* arena, void* old_memory, size old_sz, size new_sz, size align);
 void* ARENA_Resize(arena_t* arena, void* old_memory, size old_sz, size new_sz);
 
+arena_temp_t ARENA_TempBegin(arena_t* arena);
+void ARENA_TempEnd(arena_temp_t temp);
+
+arena_temp_t ARENA_GetScratch(arena_t** conflicts, uint conflicts_len);
+void ARENA_ReleaseScratch(arena_temp_t scratch);
+void ARENA_ReleaseThreadScratch(void);
+
+void ARENA_DumpStats(arena_t* arena, const char* name);
+void ARENA_DumpScratchStats(void);
+
 #endif // ARENA_H
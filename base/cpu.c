@@ -0,0 +1,51 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+static uint cpu_features;
+static bool cpu_features_detected;
+
+uint CPU_GetFeatures(void)
+{
+    if (!cpu_features_detected) {
+        uint features = 0;
+#if CPU_X86
+        // This may run before any constructor does (e.g. from memset()), so
+        // make sure the compiler's CPU model is initialized.
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2")) features |= CPUF_SSE2;
+        if (__builtin_cpu_supports("avx2")) features |= CPUF_AVX2;
+#endif
+        cpu_features = features;
+        cpu_features_detected = true;
+    }
+
+    return cpu_features;
+}
+
+void CPU_DisableFeatures(uint features)
+{
+    cpu_features = CPU_GetFeatures() & ~features;
+}
+
+bool CPU_HasFeature(cpu_feature_t feature)
+{
+    return (CPU_GetFeatures() & feature) != 0;
+}
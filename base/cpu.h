@@ -0,0 +1,50 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef CPU_H
+#define CPU_H
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CPU_X86 1
+    #define TARGET_SSE2 __attribute__((target("sse2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define CPU_X86 0
+#endif
+
+enum cpu_feature
+{
+    CPUF_SSE2 = 1 << 0,
+    CPUF_AVX2 = 1 << 1,
+};
+typedef enum cpu_feature cpu_feature_t;
+
+// Features are detected once, on first use. Anything that dispatches on these
+// must always keep a scalar path around for CPUs (or builds) without them.
+uint CPU_GetFeatures(void);
+bool CPU_HasFeature(cpu_feature_t feature);
+
+// Hides features from everything that asks afterwards, e.g. to check the SIMD
+// kernels against the scalar ones. Kernels that were already resolved have to
+// be resolved again (LIBC_Resolve(), STRING_ResolveKernels()).
+void CPU_DisableFeatures(uint features);
+
+#endif // CPU_H
@@ -0,0 +1,127 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+void INTERN_Initialize(intern_table_t* table)
+{
+    if (!ARENA_InitializeDefault(&table->arena) || !ARENA_InitializeDefault(&table->strings_arena)) {
+        ARENA_ExitOutOfMemory();
+    }
+
+    table->slots_cap = INTERN_INITIAL_CAPACITY;
+    table->slots = ARENA_Alloc(&table->arena, table->slots_cap * sizeof(intern_slot_t));
+    if (!table->slots) ARENA_ExitOutOfMemory();
+
+    table->strings_cap = INTERN_INITIAL_CAPACITY;
+    table->strings = ARENA_Alloc(&table->strings_arena, table->strings_cap * sizeof(string_t));
+    if (!table->strings) ARENA_ExitOutOfMemory();
+
+    // Symbol 0 is never handed out.
+    table->strings[SYMBOL_NONE] = STRING("");
+    table->strings_len = 1;
+}
+
+void INTERN_Release(intern_table_t* table)
+{
+    ARENA_Release(&table->arena);
+    ARENA_Release(&table->strings_arena);
+    table->slots = null;
+    table->strings = null;
+    table->slots_cap = 0;
+    table->strings_len = 0;
+    table->strings_cap = 0;
+}
+
+void INTERN_Grow(intern_table_t* table)
+{
+    // The old slots are left behind in the arena, which is at most as much
+    // memory as the current slots take.
+    uint32 new_cap = table->slots_cap * 2;
+    intern_slot_t* new_slots = ARENA_Alloc(&table->arena, new_cap * sizeof(intern_slot_t));
+    if (!new_slots) ARENA_ExitOutOfMemory();
+
+    uint32 mask = new_cap - 1;
+    for (uint32 i = 0; i < table->slots_cap; ++i) {
+        intern_slot_t slot = table->slots[i];
+        if (slot.symbol == SYMBOL_NONE) continue;
+
+        uint32 j = slot.hash & mask;
+        while (new_slots[j].symbol != SYMBOL_NONE) {
+            j = (j + 1) & mask;
+        }
+        new_slots[j] = slot;
+    }
+
+    table->slots = new_slots;
+    table->slots_cap = new_cap;
+}
+
+symbol_t INTERN_Lookup(intern_table_t* table, string_t string, bool copy)
+{
+    // Keep the load factor under 1/2 so probe sequences stay short.
+    if (table->strings_len * 2 > table->slots_cap) {
+        INTERN_Grow(table);
+    }
+
+    uint32 hash = cast(uint32) STRING_Hash(string);
+    uint32 mask = table->slots_cap - 1;
+    uint32 i = hash & mask;
+
+    while (table->slots[i].symbol != SYMBOL_NONE) {
+        intern_slot_t slot = table->slots[i];
+        if (slot.hash == hash && STRING_Equals(&table->strings[slot.symbol], &string)) {
+            return slot.symbol;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    if (table->strings_len == table->strings_cap) {
+        uint32 new_cap = table->strings_cap * 2;
+        table->strings = ARENA_Resize(&table->strings_arena, table->strings,
+                                      table->strings_cap * sizeof(string_t), new_cap * sizeof(string_t));
+        if (!table->strings) ARENA_ExitOutOfMemory();
+        table->strings_cap = new_cap;
+    }
+
+    symbol_t symbol = table->strings_len++;
+    table->strings[symbol] = copy ? STRING_Clone(string, &table->arena) : string;
+    table->slots[i].hash = hash;
+    table->slots[i].symbol = symbol;
+    return symbol;
+}
+
+symbol_t INTERN_Intern(intern_table_t* table, string_t string)
+{
+    return INTERN_Lookup(table, string, true);
+}
+
+// Like INTERN_Intern(), but a new symbol keeps pointing to `string` instead of
+// a copy of it. Only use it when `string` lives at least as long as the table.
+symbol_t INTERN_InternView(intern_table_t* table, string_t string)
+{
+    return INTERN_Lookup(table, string, false);
+}
+
+string_t INTERN_GetString(intern_table_t* table, symbol_t symbol)
+{
+    // @TODO: debug_assert(symbol < table->strings_len);
+    return table->strings[symbol];
+}
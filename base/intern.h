@@ -0,0 +1,63 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef INTERN_H
+#define INTERN_H
+
+// Interned strings are identified by a symbol: a small, stable integer that is
+// the same for every occurrence of the same string. Comparing two interned
+// strings is comparing two integers.
+typedef uint32 symbol_t;
+#define SYMBOL_NONE 0
+
+#define INTERN_INITIAL_CAPACITY 1024
+
+struct intern_slot
+{
+    uint32 hash; // Low bits of the string hash, to skip most string compares.
+    symbol_t symbol;
+};
+typedef struct intern_slot intern_slot_t;
+
+// Open addressing (linear probing) hash table from strings to symbols.
+struct intern_table
+{
+    arena_t arena;         // Slots and the canonical copies of every string.
+    arena_t strings_arena; // Only holds `strings`, so it can grow in place.
+
+    intern_slot_t* slots;
+    uint32 slots_cap;      // Always a power of two.
+
+    string_t* strings;     // Canonical string of every symbol, by symbol.
+    uint32 strings_len;    // Includes the unused SYMBOL_NONE entry.
+    uint32 strings_cap;
+};
+typedef struct intern_table intern_table_t;
+
+void INTERN_Initialize(intern_table_t* table);
+void INTERN_Release(intern_table_t* table);
+
+symbol_t INTERN_Lookup(intern_table_t* table, string_t string, bool copy);
+symbol_t INTERN_Intern(intern_table_t* table, string_t string);
+symbol_t INTERN_InternView(intern_table_t* table, string_t string);
+string_t INTERN_GetString(intern_table_t* table, symbol_t symbol);
+
+#endif // INTERN_H
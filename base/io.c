@@ -19,19 +19,121 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-string_t IO_ReadFileFromPath(const char* filename)
+static const uint8 io_empty_contents[IO_SOURCE_PADDING];
+
+bool IO_MapFile(io_file_t* file, int fd, size len)
 {
-    // @TODO: proper error checking
-    int fd = open(filename, O_RDONLY);
-    assert(fd != -1);
+    // Bytes past the end of the file up to the end of its last page read as
+    // zeroes, which is our padding. If there isn't enough of it, the file has to
+    // be copied instead: mapping pages past the end of a file raises SIGBUS.
+    size page_size = sysconf(_SC_PAGESIZE);
+    size len_in_pages = ARENA_AlignForward(len, page_size);
+    if (len_in_pages - len < IO_SOURCE_PADDING) return false;
 
-    offset len = lseek(fd, 0, SEEK_END);
     // @FIXME: This does not compile on Windows.
-    uint8* data = cast(uint8*) mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
-    assert(data != MAP_FAILED);
+    int flags = MAP_PRIVATE;
+    if (len >= IO_LARGE_FILE_SIZE) flags |= MAP_POPULATE;
+
+    uint8* data = cast(uint8*) mmap(0, len, PROT_READ, flags, fd, 0);
+    if (data == MAP_FAILED) return false;
+
+    // The lexer reads the whole file front to back exactly once.
+    // Note that these are not flags, so they need separate calls.
+    if (len >= IO_LARGE_FILE_SIZE) {
+        madvise(data, len, MADV_SEQUENTIAL);
+        madvise(data, len, MADV_WILLNEED);
+    }
+
+    file->contents = STRING_SIZED(data, len);
+    file->is_mapped = true;
+    file->mapped_len = len;
+    return true;
+}
+
+bool IO_ReadAll(io_file_t* file, int fd)
+{
+    if (!ARENA_InitializeDefault(&file->buffer)) {
+        file->error = IO_ERROR_OUT_OF_MEMORY;
+        return false;
+    }
+
+    // Everything in `buffer` is this one allocation, so reading in chunks just
+    // keeps growing it in place.
+    uint8* data = null;
+    size len = 0;
+    while (true) {
+        data = ARENA_ResizeAligned(&file->buffer, data, len, len + IO_READ_CHUNK_SIZE, 1);
+        if (data == null) {
+            file->error = IO_ERROR_OUT_OF_MEMORY;
+            return false;
+        }
+
+        ssize_t bytes_read = read(fd, data + len, IO_READ_CHUNK_SIZE);
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+
+            file->error = IO_ERROR_READ;
+            file->error_number = errno;
+            return false;
+        }
+
+        if (bytes_read == 0) break;
+        len += bytes_read;
+    }
+
+    // There is always at least one unused chunk left at this point.
+    memset(data + len, 0, IO_SOURCE_PADDING);
+
+    file->contents = STRING_SIZED(data, len);
+    return true;
+}
+
+io_file_t IO_OpenFile(const char* path)
+{
+    io_file_t file;
+    memset(&file, 0, sizeof(file));
+    file.contents = STRING_SIZED(io_empty_contents, 0);
+
+    bool is_stdin = path[0] == '-' && path[1] == '\0';
+    int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd == -1) {
+        file.error = IO_ERROR_OPEN;
+        file.error_number = errno;
+        return file;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        file.error = IO_ERROR_STAT;
+        file.error_number = errno;
+    } else {
+        // Pipes, terminals and such can't be mapped. Neither can empty files,
+        // but some "empty" files (e.g. in /proc) still have contents to read().
+        bool mapped = S_ISREG(file_stat.st_mode)
+            && file_stat.st_size > 0
+            && IO_MapFile(&file, fd, file_stat.st_size);
+
+        if (!mapped && !IO_ReadAll(&file, fd)) {
+            IO_CloseFile(&file);
+        }
+    }
+
+    // The mapping stays valid after closing the descriptor.
+    if (!is_stdin) close(fd);
+    return file;
+}
+
+void IO_CloseFile(io_file_t* file)
+{
+    if (file->is_mapped) {
+        munmap(file->contents.data, file->mapped_len);
+        file->is_mapped = false;
+        file->mapped_len = 0;
+    }
+
+    if (file->buffer.buf != null) {
+        ARENA_Release(&file->buffer);
+    }
 
-    string_t contents = STRING("");
-    contents.data = data;
-    contents.len = len-1;
-    return contents;
+    file->contents = STRING_SIZED(io_empty_contents, 0);
 }
@@ -22,6 +22,51 @@
 #ifndef IO_H
 #define IO_H
 
-string_t IO_ReadFileFromPath(const char* filename);
+// Files at least this big are read ahead and prefaulted when they are mapped.
+#define IO_LARGE_FILE_SIZE (cast(size) 1 << 20)
+// Chunk size for files that have to be read() instead of mapped (pipes etc.)
+#define IO_READ_CHUNK_SIZE (cast(size) 1 << 20)
+// Contents are always followed by at least this many zero bytes, so scanners
+// can use the NUL as a sentinel and do full-width vector loads up to the end.
+#define IO_SOURCE_PADDING 64
+
+enum io_error
+{
+    IO_ERROR_NONE,
+    IO_ERROR_OPEN,
+    IO_ERROR_STAT,
+    IO_ERROR_READ,
+    IO_ERROR_OUT_OF_MEMORY,
+};
+typedef enum io_error io_error_t;
+
+static const char* io_error_names[] = {
+    [IO_ERROR_NONE] = "no error",
+    [IO_ERROR_OPEN] = "could not open",
+    [IO_ERROR_STAT] = "could not stat",
+    [IO_ERROR_READ] = "could not read",
+    [IO_ERROR_OUT_OF_MEMORY] = "ran out of memory reading",
+};
+
+struct io_file
+{
+    string_t contents;
+
+    io_error_t error;
+    int error_number; // errno of the call that failed, if any.
+
+    // Regular files are mapped, as long as the rest of their last page can hold
+    // the padding. Anything else (pipes, stdin, empty or special files, or
+    // files that end too close to a page boundary) is read into `buffer`.
+    // IO_CloseFile() releases either.
+    bool is_mapped;
+    size mapped_len;
+    arena_t buffer;
+};
+typedef struct io_file io_file_t;
+
+// Passing "-" as the path reads from stdin.
+io_file_t IO_OpenFile(const char* path);
+void IO_CloseFile(io_file_t* file);
 
 #endif // IO_H
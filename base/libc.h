@@ -22,31 +22,297 @@
 #ifndef LIBC_H
 #define LIBC_H
 
-// These are memset() and memmove() implementations from gcc's libc.
+// These are memset(), memmove(), memcpy() and memcmp() implementations.
 // This file exists just because I don't want to include string.h.
-void* memset(void* dest, int val, size len)
+//
+// Every function has a portable version that works on 64-bit words, plus SSE2
+// and AVX2 versions on x86. The best one is picked the first time any of them
+// is called, based on what the CPU supports.
+
+// gcc turns plain byte loops into calls to memset()/memcpy() with optimizations
+// on, which would recurse right back into these functions.
+#if defined(__GNUC__) && !defined(__clang__)
+    #define LIBC_FUNCTION __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#else
+    #define LIBC_FUNCTION
+#endif
+
+// Unaligned, aliasing-safe 64-bit word.
+typedef uint64 __attribute__((aligned(1), may_alias)) libc_word_t;
+
+/* Portable versions */
+
+LIBC_FUNCTION void* LIBC_MemsetWord(void* dest, int val, size len)
 {
-    byte* ptr = dest;
-    while (len-- > 0) *ptr++ = val;
+    byte* d = dest;
+    uint64 word = cast(uint64) cast(byte) val * 0x0101010101010101ull;
+
+    for (; len >= sizeof(uint64); len -= sizeof(uint64), d += sizeof(uint64)) {
+        *cast(libc_word_t*) d = word;
+    }
 
+    while (len-- > 0) *d++ = val;
     return dest;
 }
 
-void* memmove(void* dest, const void* src, size len)
+// Copies front to back. This is also safe for overlapping moves where dest < src,
+// since every word is loaded before anything at or after it is stored.
+LIBC_FUNCTION void* LIBC_CopyForwardWord(void* dest, const void* src, size len)
+{
+    byte* d = dest;
+    const byte* s = src;
+
+    for (; len >= sizeof(uint64); len -= sizeof(uint64), d += sizeof(uint64), s += sizeof(uint64)) {
+        *cast(libc_word_t*) d = *cast(const libc_word_t*) s;
+    }
+
+    while (len--) *d++ = *s++;
+    return dest;
+}
+
+// Copies back to front, for overlapping moves where dest > src.
+LIBC_FUNCTION void* LIBC_CopyBackwardWord(void* dest, const void* src, size len)
+{
+    byte* d = cast(byte*) dest + len;
+    const byte* s = cast(const byte*) src + len;
+
+    for (; len >= sizeof(uint64); len -= sizeof(uint64)) {
+        d -= sizeof(uint64);
+        s -= sizeof(uint64);
+        *cast(libc_word_t*) d = *cast(const libc_word_t*) s;
+    }
+
+    while (len--) *--d = *--s;
+    return dest;
+}
+
+LIBC_FUNCTION int LIBC_MemcmpWord(const void* ptr1, const void* ptr2, size len)
+{
+    const byte* p1 = ptr1;
+    const byte* p2 = ptr2;
+
+    for (; len >= sizeof(uint64); len -= sizeof(uint64), p1 += sizeof(uint64), p2 += sizeof(uint64)) {
+        if (*cast(const libc_word_t*) p1 != *cast(const libc_word_t*) p2) break;
+    }
+
+    // Either the tail, or the word that differs.
+    for (; len > 0; --len, ++p1, ++p2) {
+        if (*p1 != *p2) return *p1 - *p2;
+    }
+
+    return 0;
+}
+
+#if CPU_X86
+/* SSE2 versions */
+
+TARGET_SSE2 LIBC_FUNCTION void* LIBC_MemsetSSE2(void* dest, int val, size len)
 {
-    char* d = dest;
-    const char* s = src;
+    byte* d = dest;
+    __m128i v = _mm_set1_epi8(cast(char) val);
+
+    for (; len >= 16; len -= 16, d += 16) {
+        _mm_storeu_si128(cast(__m128i*) d, v);
+    }
 
-    if (d < s)
-        while (len--) *d++ =*s++;
-    else {
-        char* lasts = s + (len-1);
-        char* lastd = d + (len-1);
+    LIBC_MemsetWord(d, val, len);
+    return dest;
+}
+
+TARGET_SSE2 LIBC_FUNCTION void* LIBC_CopyForwardSSE2(void* dest, const void* src, size len)
+{
+    byte* d = dest;
+    const byte* s = src;
+
+    for (; len >= 16; len -= 16, d += 16, s += 16) {
+        _mm_storeu_si128(cast(__m128i*) d, _mm_loadu_si128(cast(const __m128i*) s));
+    }
+
+    LIBC_CopyForwardWord(d, s, len);
+    return dest;
+}
+
+TARGET_SSE2 LIBC_FUNCTION void* LIBC_CopyBackwardSSE2(void* dest, const void* src, size len)
+{
+    byte* d = cast(byte*) dest + len;
+    const byte* s = cast(const byte*) src + len;
+
+    for (; len >= 16; len -= 16) {
+        d -= 16;
+        s -= 16;
+        _mm_storeu_si128(cast(__m128i*) d, _mm_loadu_si128(cast(const __m128i*) s));
+    }
+
+    LIBC_CopyBackwardWord(dest, src, len);
+    return dest;
+}
+
+TARGET_SSE2 LIBC_FUNCTION int LIBC_MemcmpSSE2(const void* ptr1, const void* ptr2, size len)
+{
+    const byte* p1 = ptr1;
+    const byte* p2 = ptr2;
+
+    for (; len >= 16; len -= 16, p1 += 16, p2 += 16) {
+        __m128i a = _mm_loadu_si128(cast(const __m128i*) p1);
+        __m128i b = _mm_loadu_si128(cast(const __m128i*) p2);
+        uint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        if (mask != 0xFFFF) {
+            uint i = __builtin_ctz(~mask);
+            return p1[i] - p2[i];
+        }
+    }
+
+    return LIBC_MemcmpWord(p1, p2, len);
+}
+
+/* AVX2 versions */
+
+TARGET_AVX2 LIBC_FUNCTION void* LIBC_MemsetAVX2(void* dest, int val, size len)
+{
+    byte* d = dest;
+    __m256i v = _mm256_set1_epi8(cast(char) val);
 
-        while (len--) *lastd-- = *lasts--;
+    for (; len >= 32; len -= 32, d += 32) {
+        _mm256_storeu_si256(cast(__m256i*) d, v);
     }
 
+    LIBC_MemsetWord(d, val, len);
     return dest;
 }
 
+TARGET_AVX2 LIBC_FUNCTION void* LIBC_CopyForwardAVX2(void* dest, const void* src, size len)
+{
+    byte* d = dest;
+    const byte* s = src;
+
+    for (; len >= 32; len -= 32, d += 32, s += 32) {
+        _mm256_storeu_si256(cast(__m256i*) d, _mm256_loadu_si256(cast(const __m256i*) s));
+    }
+
+    LIBC_CopyForwardWord(d, s, len);
+    return dest;
+}
+
+TARGET_AVX2 LIBC_FUNCTION void* LIBC_CopyBackwardAVX2(void* dest, const void* src, size len)
+{
+    byte* d = cast(byte*) dest + len;
+    const byte* s = cast(const byte*) src + len;
+
+    for (; len >= 32; len -= 32) {
+        d -= 32;
+        s -= 32;
+        _mm256_storeu_si256(cast(__m256i*) d, _mm256_loadu_si256(cast(const __m256i*) s));
+    }
+
+    LIBC_CopyBackwardWord(dest, src, len);
+    return dest;
+}
+
+TARGET_AVX2 LIBC_FUNCTION int LIBC_MemcmpAVX2(const void* ptr1, const void* ptr2, size len)
+{
+    const byte* p1 = ptr1;
+    const byte* p2 = ptr2;
+
+    for (; len >= 32; len -= 32, p1 += 32, p2 += 32) {
+        __m256i a = _mm256_loadu_si256(cast(const __m256i*) p1);
+        __m256i b = _mm256_loadu_si256(cast(const __m256i*) p2);
+        uint mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        if (mask != 0xFFFFFFFF) {
+            uint i = __builtin_ctz(~mask);
+            return p1[i] - p2[i];
+        }
+    }
+
+    return LIBC_MemcmpWord(p1, p2, len);
+}
+#endif // CPU_X86
+
+/* Dispatch */
+
+void* LIBC_MemsetFirst(void* dest, int val, size len);
+void* LIBC_CopyForwardFirst(void* dest, const void* src, size len);
+void* LIBC_CopyBackwardFirst(void* dest, const void* src, size len);
+int LIBC_MemcmpFirst(const void* ptr1, const void* ptr2, size len);
+
+// These start out pointing to the *First() functions, which pick the real
+// implementation on the first call.
+static void* (*libc_memset)(void*, int, size) = LIBC_MemsetFirst;
+static void* (*libc_copy_forward)(void*, const void*, size) = LIBC_CopyForwardFirst;
+static void* (*libc_copy_backward)(void*, const void*, size) = LIBC_CopyBackwardFirst;
+static int (*libc_memcmp)(const void*, const void*, size) = LIBC_MemcmpFirst;
+
+void LIBC_Resolve(void)
+{
+    libc_memset = LIBC_MemsetWord;
+    libc_copy_forward = LIBC_CopyForwardWord;
+    libc_copy_backward = LIBC_CopyBackwardWord;
+    libc_memcmp = LIBC_MemcmpWord;
+
+#if CPU_X86
+    if (CPU_HasFeature(CPUF_AVX2)) {
+        libc_memset = LIBC_MemsetAVX2;
+        libc_copy_forward = LIBC_CopyForwardAVX2;
+        libc_copy_backward = LIBC_CopyBackwardAVX2;
+        libc_memcmp = LIBC_MemcmpAVX2;
+    } else if (CPU_HasFeature(CPUF_SSE2)) {
+        libc_memset = LIBC_MemsetSSE2;
+        libc_copy_forward = LIBC_CopyForwardSSE2;
+        libc_copy_backward = LIBC_CopyBackwardSSE2;
+        libc_memcmp = LIBC_MemcmpSSE2;
+    }
+#endif
+}
+
+void* LIBC_MemsetFirst(void* dest, int val, size len)
+{
+    LIBC_Resolve();
+    return libc_memset(dest, val, len);
+}
+
+void* LIBC_CopyForwardFirst(void* dest, const void* src, size len)
+{
+    LIBC_Resolve();
+    return libc_copy_forward(dest, src, len);
+}
+
+void* LIBC_CopyBackwardFirst(void* dest, const void* src, size len)
+{
+    LIBC_Resolve();
+    return libc_copy_backward(dest, src, len);
+}
+
+int LIBC_MemcmpFirst(const void* ptr1, const void* ptr2, size len)
+{
+    LIBC_Resolve();
+    return libc_memcmp(ptr1, ptr2, len);
+}
+
+void* memset(void* dest, int val, size len)
+{
+    return libc_memset(dest, val, len);
+}
+
+void* memcpy(void* dest, const void* src, size len)
+{
+    return libc_copy_forward(dest, src, len);
+}
+
+void* memmove(void* dest, const void* src, size len)
+{
+    const byte* d = dest;
+    const byte* s = src;
+
+    // Only copy backwards when dest starts inside of src.
+    if (d <= s || d >= s + len) {
+        return libc_copy_forward(dest, src, len);
+    }
+
+    return libc_copy_backward(dest, src, len);
+}
+
+int memcmp(const void* ptr1, const void* ptr2, size len)
+{
+    return libc_memcmp(ptr1, ptr2, len);
+}
+
 #endif // LIBC_H
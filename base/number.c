@@ -0,0 +1,143 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Powers of ten that a float64 holds exactly.
+static const float64 number_exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Integers up to this convert to a float64 exactly.
+#define NUMBER_MAX_EXACT_MANTISSA (cast(uint64) 1 << 53)
+
+// The eight digits in `word` are ASCII bytes with '0' already subtracted, the
+// first one in the lowest byte.
+static force_inline uint64 NUMBER_CombineDigits(uint64 word)
+{
+    // Neighbouring digits are combined into 2-digit numbers, then those into
+    // 4-digit numbers, then into one, each step within a single multiply. See
+    // https://lemire.me/blog/2022/01/21/swar-explained-parsing-eight-digits/
+    word = word * 10 + (word >> 8);
+    word = (((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+          + (((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return word;
+}
+
+static force_inline uint64 NUMBER_LoadDigits(const uint8* digits)
+{
+    uint64 word = *cast(const libc_word_t*) digits;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word - 0x3030303030303030ull;
+}
+
+uint64 NUMBER_ParseEightDigits(const uint8* digits)
+{
+    return NUMBER_CombineDigits(NUMBER_LoadDigits(digits));
+}
+
+// Appends `count` digits to `value`. The caller makes sure it cannot overflow.
+static force_inline uint64 NUMBER_AccumulateDigits(uint64 value, const uint8* digits, size count)
+{
+    static const uint64 powers_of_ten[8] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+    size i = 0;
+    for (; i + 8 <= count; i += 8) {
+        value = value * 100000000 + NUMBER_ParseEightDigits(digits + i);
+    }
+
+    // The rest is loaded as a whole word too, and shifted so that it turns
+    // into leading zeros of an 8-digit number. Whatever the load read past
+    // the last digit is shifted out.
+    size rest = count - i;
+    if (rest > 0) {
+        uint64 word = NUMBER_LoadDigits(digits + i) << ((8 - rest) * 8);
+        value = value * powers_of_ten[rest] + NUMBER_CombineDigits(word);
+    }
+    return value;
+}
+
+bool NUMBER_ParseInteger(string_t digits, uint64* value)
+{
+    size i = 0;
+    while (i < digits.len && digits.data[i] == '0') i += 1;
+
+    size count = digits.len - i;
+    if (count > NUMBER_MAX_SAFE_DIGITS + 1) return false;
+
+    size safe_count = count < NUMBER_MAX_SAFE_DIGITS ? count : NUMBER_MAX_SAFE_DIGITS;
+    uint64 result = NUMBER_AccumulateDigits(0, digits.data + i, safe_count);
+
+    if (count > safe_count) {
+        uint64 last = cast(uint64) (digits.data[digits.len-1] - '0');
+        if (result > (UINT64_MAX - last) / 10) return false;
+        result = result * 10 + last;
+    }
+
+    *value = result;
+    return true;
+}
+
+bool NUMBER_ParseDecimal(string_t literal, size dot, float64* value)
+{
+    assert(dot < literal.len && literal.data[dot] == '.');
+
+    // Neither leading nor trailing zeros change the value.
+    size begin = 0;
+    while (begin < dot && literal.data[begin] == '0') begin += 1;
+
+    size end = literal.len;
+    while (end > dot + 1 && literal.data[end-1] == '0') end -= 1;
+
+    size whole_count = dot - begin;
+    size fraction_count = end - (dot + 1);
+
+    // Clinger's fast path: when both the digits, as an integer, and the power
+    // of ten they are divided by are exact float64s, a single division
+    // rounds correctly. That is every literal with up to 15 significant digits
+    // and at most 22 of them after the dot.
+    if (whole_count + fraction_count <= NUMBER_MAX_SAFE_DIGITS && fraction_count < countof(number_exact_powers_of_ten)) {
+        uint64 mantissa = NUMBER_AccumulateDigits(0, literal.data + begin, whole_count);
+        mantissa = NUMBER_AccumulateDigits(mantissa, literal.data + dot + 1, fraction_count);
+
+        if (mantissa <= NUMBER_MAX_EXACT_MANTISSA) {
+            *value = cast(float64) mantissa / number_exact_powers_of_ten[fraction_count];
+            return true;
+        }
+    }
+
+    // Everything else is rare enough for strtod(), which needs a terminator.
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    char* terminated = ARENA_AllocNoZero(scratch.arena, literal.len + 1);
+    if (!terminated) ARENA_ExitOutOfMemory();
+
+    memcpy(terminated, literal.data, literal.len);
+    terminated[literal.len] = '\0';
+
+    errno = 0;
+    float64 result = strtod(terminated, null);
+    bool in_range = !(errno == ERANGE && result == HUGE_VAL);
+    ARENA_ReleaseScratch(scratch);
+
+    *value = result;
+    return in_range;
+}
@@ -0,0 +1,43 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef NUMBER_H
+#define NUMBER_H
+
+// Conversions from decimal digits to values, for number literals.
+//
+// Digits are read eight at a time, so all of these may read up to 7 bytes
+// past the end of the string. The lexer's source padding allows for that.
+
+// Every 19-digit number fits in 64 bits, some 20-digit ones do too.
+#define NUMBER_MAX_SAFE_DIGITS 19
+
+// Reads exactly 8 ASCII digits.
+uint64 NUMBER_ParseEightDigits(const uint8* digits);
+
+// `digits` is [0-9]+. Returns false if the value does not fit in 64 bits.
+bool NUMBER_ParseInteger(string_t digits, uint64* value);
+
+// `literal` is [0-9]+ '.' [0-9]*, with the dot at `dot`. The result is
+// correctly rounded. Returns false if the value is too big for a float64.
+bool NUMBER_ParseDecimal(string_t literal, size dot, float64* value);
+
+#endif // NUMBER_H
@@ -19,48 +19,250 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-string_t STRING_Append(string_t string, uint8 c, arena_t* arena)
+string_t STRING_Clone(string_t string, arena_t* arena)
+{
+    uint8* new_data = cast(uint8*) ARENA_AllocNoZero(arena, string.len);
+    if (!new_data) ARENA_ExitOutOfMemory();
+
+    memcpy(new_data, string.data, string.len);
+    return STRING_SIZED(new_data, string.len);
+}
+
+string_t STRING_FromCString(const char* cstring)
 {
-    // @FIXME: This is not the fastest approach.
-    uint8* new_data = cast(uint8*) ARENA_Alloc(arena, string.len+1);
-    assert(new_data);
+    size len = 0;
+    while (cstring[len] != '\0') len += 1;
+    return STRING_SIZED(cstring, len);
+}
+
+bool STRING_Equals(string_t* string1, string_t* string2) {
+    if (string1->len != string2->len) return false;
+    return memcmp(string1->data, string2->data, string1->len) == 0;
+}
+
+uint64 STRING_Hash(string_t string)
+{
+    // Word-at-a-time multiply/xorshift hash, finished with MurmurHash3's fmix64
+    // so that every input bit affects every output bit.
+    const uint64 k = 0x9e3779b97f4a7c15ull;
+    const uint8* p = string.data;
+    size len = string.len;
+    uint64 hash = len * k;
+
+    for (; len >= sizeof(uint64); len -= sizeof(uint64), p += sizeof(uint64)) {
+        hash = (hash ^ *cast(const libc_word_t*) p) * k;
+        hash ^= hash >> 29;
+    }
 
-    for (size i = 0; i < string.len; ++i) {
-        new_data[i] = string.data[i];
+    uint64 tail = 0;
+    for (size i = 0; i < len; ++i) {
+        tail |= cast(uint64) p[i] << (i*8);
     }
+    hash = (hash ^ tail) * k;
 
-    new_data[string.len] = c;
-    return STRING_SIZED(new_data, string.len+1);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
 }
 
-string_t STRING_Clone(string_t string, arena_t* arena)
+/* Byte search and character classes */
+
+#define CHAR_CLASS_BIT(class) (1 << (class))
+
+static const uint8 string_char_classes[256] = {
+    ['0' ... '9'] = CHAR_CLASS_BIT(CHAR_CLASS_DIGIT) | CHAR_CLASS_BIT(CHAR_CLASS_NUMBER) | CHAR_CLASS_BIT(CHAR_CLASS_IDENTIFIER),
+    ['.']         = CHAR_CLASS_BIT(CHAR_CLASS_NUMBER),
+    ['A' ... 'Z'] = CHAR_CLASS_BIT(CHAR_CLASS_IDENTIFIER),
+    ['a' ... 'z'] = CHAR_CLASS_BIT(CHAR_CLASS_IDENTIFIER),
+    ['_']         = CHAR_CLASS_BIT(CHAR_CLASS_IDENTIFIER),
+    [' ']         = CHAR_CLASS_BIT(CHAR_CLASS_WHITESPACE),
+    ['\t']        = CHAR_CLASS_BIT(CHAR_CLASS_WHITESPACE),
+    ['\r']        = CHAR_CLASS_BIT(CHAR_CLASS_WHITESPACE),
+    ['\n']        = CHAR_CLASS_BIT(CHAR_CLASS_WHITESPACE),
+};
+
+size STRING_FindByteScalar(const uint8* data, size from, size len, uint8 c)
 {
-    uint8* new_data = cast(uint8*) ARENA_Alloc(arena, string.len);
-    assert(new_data);
+    size i = from;
+    while (i < len && data[i] != c) i += 1;
+    return i;
+}
+
+size STRING_SkipClassScalar(const uint8* data, size from, size len, char_class_t class)
+{
+    uint8 bit = CHAR_CLASS_BIT(class);
+    size i = from;
+    while (i < len && (string_char_classes[data[i]] & bit)) i += 1;
+    return i;
+}
 
-    for (size i = 0; i < string.len; ++i) {
-        new_data[i] = string.data[i];
+#if CPU_X86
+// Bytes >= 0x80 are negative for the signed compares below, so they never
+// fall into any of the (ASCII) ranges. For identifiers, OR-ing 0x20 folds A-Z
+// into a-z without folding anything else into it.
+// The constants are hoisted and every class gets its own loop, so that this
+// stays fast in unoptimized builds too.
+#define STRING_SKIP_LOOP(width, load, movemask, all_ones, in_class) \
+    for (; i + width <= len; i += width) { \
+        v = load(cast(const void*) (data + i)); \
+        uint mask = movemask(in_class); \
+        if (mask != all_ones) return i + __builtin_ctz(~mask); \
     }
 
-    return STRING_SIZED(new_data, string.len);
+TARGET_SSE2 size STRING_FindByteSSE2(const uint8* data, size from, size len, uint8 c)
+{
+    size i = from;
+    __m128i needle = _mm_set1_epi8(c);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(cast(const __m128i*) (data + i));
+        uint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+
+    return STRING_FindByteScalar(data, i, len, c);
 }
 
-string_t STRING_FromChar(char c, arena_t* arena)
+TARGET_AVX2 size STRING_FindByteAVX2(const uint8* data, size from, size len, uint8 c)
 {
-    uint8* data = cast(uint8*) ARENA_Alloc(arena, 1);
-    assert(data);
+    size i = from;
+    __m256i needle = _mm256_set1_epi8(c);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(cast(const __m256i*) (data + i));
+        uint mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
 
-    data[0] = cast(uint8) c;
-    return STRING_SIZED(data, 1);
+    return STRING_FindByteScalar(data, i, len, c);
 }
 
-bool STRING_Equals(string_t* string1, string_t* string2) {
-    if (string1->len != string2->len) return false;
-    for (size i = 0; i < string1->len; ++i) {
-        if (string1->data[i] != string2->data[i]) {
-            return false;
-        }
+TARGET_SSE2 size STRING_SkipClassSSE2(const uint8* data, size from, size len, char_class_t class)
+{
+    #define LOAD(p)             _mm_loadu_si128(p)
+    #define IN_RANGE(x, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(x, lo), _mm_cmplt_epi8(x, hi))
+    const __m128i below_0 = _mm_set1_epi8('0'-1), above_9 = _mm_set1_epi8('9'+1);
+    const __m128i below_a = _mm_set1_epi8('a'-1), above_z = _mm_set1_epi8('z'+1);
+    const __m128i fold = _mm_set1_epi8(0x20), underscore = _mm_set1_epi8('_'), dot = _mm_set1_epi8('.');
+    const __m128i space = _mm_set1_epi8(' '), newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t'), carriage_return = _mm_set1_epi8('\r');
+
+    size i = from;
+    __m128i v;
+    switch (class) {
+        case CHAR_CLASS_DIGIT:
+            STRING_SKIP_LOOP(16, LOAD, _mm_movemask_epi8, 0xFFFF, IN_RANGE(v, below_0, above_9));
+            break;
+        case CHAR_CLASS_NUMBER:
+            STRING_SKIP_LOOP(16, LOAD, _mm_movemask_epi8, 0xFFFF,
+                _mm_or_si128(IN_RANGE(v, below_0, above_9), _mm_cmpeq_epi8(v, dot)));
+            break;
+        case CHAR_CLASS_IDENTIFIER:
+            STRING_SKIP_LOOP(16, LOAD, _mm_movemask_epi8, 0xFFFF,
+                _mm_or_si128(_mm_or_si128(IN_RANGE(v, below_0, above_9),
+                                          IN_RANGE(_mm_or_si128(v, fold), below_a, above_z)),
+                             _mm_cmpeq_epi8(v, underscore)));
+            break;
+        case CHAR_CLASS_WHITESPACE:
+            STRING_SKIP_LOOP(16, LOAD, _mm_movemask_epi8, 0xFFFF,
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, carriage_return))));
+            break;
+    }
+    #undef LOAD
+    #undef IN_RANGE
+
+    return STRING_SkipClassScalar(data, i, len, class);
+}
+
+TARGET_AVX2 size STRING_SkipClassAVX2(const uint8* data, size from, size len, char_class_t class)
+{
+    #define LOAD(p)             _mm256_loadu_si256(p)
+    #define IN_RANGE(x, lo, hi) _mm256_and_si256(_mm256_cmpgt_epi8(x, lo), _mm256_cmpgt_epi8(hi, x))
+    const __m256i below_0 = _mm256_set1_epi8('0'-1), above_9 = _mm256_set1_epi8('9'+1);
+    const __m256i below_a = _mm256_set1_epi8('a'-1), above_z = _mm256_set1_epi8('z'+1);
+    const __m256i fold = _mm256_set1_epi8(0x20), underscore = _mm256_set1_epi8('_'), dot = _mm256_set1_epi8('.');
+    const __m256i space = _mm256_set1_epi8(' '), newline = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t'), carriage_return = _mm256_set1_epi8('\r');
+
+    size i = from;
+    __m256i v;
+    switch (class) {
+        case CHAR_CLASS_DIGIT:
+            STRING_SKIP_LOOP(32, LOAD, _mm256_movemask_epi8, 0xFFFFFFFF, IN_RANGE(v, below_0, above_9));
+            break;
+        case CHAR_CLASS_NUMBER:
+            STRING_SKIP_LOOP(32, LOAD, _mm256_movemask_epi8, 0xFFFFFFFF,
+                _mm256_or_si256(IN_RANGE(v, below_0, above_9), _mm256_cmpeq_epi8(v, dot)));
+            break;
+        case CHAR_CLASS_IDENTIFIER:
+            STRING_SKIP_LOOP(32, LOAD, _mm256_movemask_epi8, 0xFFFFFFFF,
+                _mm256_or_si256(_mm256_or_si256(IN_RANGE(v, below_0, above_9),
+                                                IN_RANGE(_mm256_or_si256(v, fold), below_a, above_z)),
+                                _mm256_cmpeq_epi8(v, underscore)));
+            break;
+        case CHAR_CLASS_WHITESPACE:
+            STRING_SKIP_LOOP(32, LOAD, _mm256_movemask_epi8, 0xFFFFFFFF,
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, newline)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, carriage_return))));
+            break;
+    }
+    #undef LOAD
+    #undef IN_RANGE
+
+    return STRING_SkipClassScalar(data, i, len, class);
+}
+#endif // CPU_X86
+
+size STRING_FindByteFirst(const uint8* data, size from, size len, uint8 c);
+size STRING_SkipClassFirst(const uint8* data, size from, size len, char_class_t class);
+
+// Same idea as in libc.h: resolved on the first call.
+static size (*string_find_byte)(const uint8*, size, size, uint8) = STRING_FindByteFirst;
+static size (*string_skip_class)(const uint8*, size, size, char_class_t) = STRING_SkipClassFirst;
+
+void STRING_ResolveKernels(void)
+{
+    string_find_byte = STRING_FindByteScalar;
+    string_skip_class = STRING_SkipClassScalar;
+
+#if CPU_X86
+    if (CPU_HasFeature(CPUF_AVX2)) {
+        string_find_byte = STRING_FindByteAVX2;
+        string_skip_class = STRING_SkipClassAVX2;
+    } else if (CPU_HasFeature(CPUF_SSE2)) {
+        string_find_byte = STRING_FindByteSSE2;
+        string_skip_class = STRING_SkipClassSSE2;
     }
+#endif
+}
+
+size STRING_FindByteFirst(const uint8* data, size from, size len, uint8 c)
+{
+    STRING_ResolveKernels();
+    return string_find_byte(data, from, len, c);
+}
+
+size STRING_SkipClassFirst(const uint8* data, size from, size len, char_class_t class)
+{
+    STRING_ResolveKernels();
+    return string_skip_class(data, from, len, class);
+}
 
-    return true;
+bool STRING_IsInClass(uint8 c, char_class_t class)
+{
+    return (string_char_classes[c] & CHAR_CLASS_BIT(class)) != 0;
+}
+
+size STRING_FindByte(string_t string, size from, uint8 c)
+{
+    if (from >= string.len) return string.len;
+    return string_find_byte(string.data, from, string.len, c);
+}
+
+size STRING_FindFirstNotInClass(string_t string, size from, char_class_t class)
+{
+    if (from >= string.len) return string.len;
+    return string_skip_class(string.data, from, string.len, class);
 }
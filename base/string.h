@@ -35,9 +35,27 @@ typedef struct string string_t;
 #define STRING_SIZED(s, l) cast(string_t) {(uint8*)s, l}
 #define STRING(s)          cast(string_t) {(uint8*)s, lengthof(s)}
 
-string_t STRING_Append(string_t string, uint8 c, arena_t* arena);
+// Character classes understood by STRING_FindFirstNotInClass().
+enum char_class
+{
+    CHAR_CLASS_DIGIT,      // [0-9]
+    CHAR_CLASS_NUMBER,     // [0-9.]
+    CHAR_CLASS_IDENTIFIER, // [A-Za-z0-9_]
+    CHAR_CLASS_WHITESPACE, // [ \t\r\n]
+};
+typedef enum char_class char_class_t;
+
+void STRING_ResolveKernels(void);
+
 string_t STRING_Clone(string_t string, arena_t* arena);
-string_t STRING_FromChar(char c, arena_t* arena);
+string_t STRING_FromCString(const char* cstring);
 bool STRING_Equals(string_t* string1, string_t* string2);
+uint64 STRING_Hash(string_t string);
+
+// Both return the index of the first match at or after `from`, or string.len
+// if there is none. They use SSE2/AVX2 when the CPU has it.
+bool STRING_IsInClass(uint8 c, char_class_t class);
+size STRING_FindByte(string_t string, size from, uint8 c);
+size STRING_FindFirstNotInClass(string_t string, size from, char_class_t class);
 
 #endif // STRING_H
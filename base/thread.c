@@ -0,0 +1,53 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+uint THREAD_GetCPUCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? cast(uint) count : 1;
+}
+
+void* THREAD_Entry(void* thread)
+{
+    thread_t* self = cast(thread_t*) thread;
+    self->function(self->data);
+    return null;
+}
+
+bool THREAD_Start(thread_t* thread, thread_function_t function, void* data)
+{
+    thread->function = function;
+    thread->data = data;
+    thread->started = pthread_create(&thread->handle, null, THREAD_Entry, thread) == 0;
+    return thread->started;
+}
+
+void THREAD_Join(thread_t* thread)
+{
+    if (thread->started) {
+        pthread_join(thread->handle, null);
+    } else if (thread->function != null) {
+        thread->function(thread->data);
+    }
+
+    thread->started = false;
+    thread->function = null;
+}
@@ -0,0 +1,45 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef THREAD_H
+#define THREAD_H
+
+typedef void (*thread_function_t)(void* data);
+
+struct thread
+{
+    pthread_t handle;
+    thread_function_t function;
+    void* data;
+    bool started;
+};
+typedef struct thread thread_t;
+
+// Number of CPUs that are online, at least one.
+uint THREAD_GetCPUCount(void);
+
+// Returns false if the thread could not be started. THREAD_Join() is still
+// fine to call then, and runs `function` on the calling thread instead, so
+// callers never need a separate serial path.
+bool THREAD_Start(thread_t* thread, thread_function_t function, void* data);
+void THREAD_Join(thread_t* thread);
+
+#endif // THREAD_H
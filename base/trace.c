@@ -0,0 +1,56 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+static trace_level_t trace_levels[TRACE_CATEGORY_COUNT];
+
+static char trace_buffer[TRACE_BUFFER_SIZE];
+static bool trace_buffer_installed;
+
+void TRACE_SetLevel(trace_category_t category, trace_level_t level)
+{
+    assert(category < TRACE_CATEGORY_COUNT);
+    trace_levels[category] = level;
+
+    // stdout is line buffered on a terminal, which means a write() per token.
+    // This has to happen before anything is written to it.
+    if (!trace_buffer_installed) {
+        setvbuf(stdout, trace_buffer, _IOFBF, TRACE_BUFFER_SIZE);
+        trace_buffer_installed = true;
+    }
+}
+
+bool TRACE_IsEnabled(trace_category_t category, trace_level_t level)
+{
+    return trace_levels[category] >= level;
+}
+
+void TRACE_Printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+}
+
+void TRACE_Flush(void)
+{
+    fflush(stdout);
+}
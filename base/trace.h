@@ -0,0 +1,67 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Debug output of the lexer, parser etc. Build with -DTRACE_ENABLED=1 to be
+// able to turn it on at runtime, otherwise the TRACE_*() macros compile to
+// nothing.
+#ifndef TRACE_ENABLED
+    #define TRACE_ENABLED 0
+#endif
+
+// Output goes to stdout through a single buffer of this size.
+#define TRACE_BUFFER_SIZE (cast(size) 64 << 10)
+
+enum trace_category
+{
+    TRACE_LEX,   // Every token.
+    TRACE_PARSE, // What the parser decides to parse.
+    TRACE_AST,   // The finished tree.
+
+    TRACE_CATEGORY_COUNT,
+};
+typedef enum trace_category trace_category_t;
+
+enum trace_level
+{
+    TRACE_LEVEL_OFF,
+    TRACE_LEVEL_INFO,
+    TRACE_LEVEL_VERBOSE,
+};
+typedef enum trace_level trace_level_t;
+
+#if TRACE_ENABLED
+    #define TRACE_IS_ENABLED(category, level) TRACE_IsEnabled(category, level)
+    #define TRACE_PRINTF(category, level, ...) \
+        do { if (TRACE_IsEnabled(category, level)) TRACE_Printf(__VA_ARGS__); } while (0)
+#else
+    #define TRACE_IS_ENABLED(category, level) false
+    #define TRACE_PRINTF(category, level, ...) do { } while (0)
+#endif
+
+void TRACE_SetLevel(trace_category_t category, trace_level_t level);
+bool TRACE_IsEnabled(trace_category_t category, trace_level_t level);
+void TRACE_Printf(const char* format, ...);
+void TRACE_Flush(void);
+
+#endif // TRACE_H
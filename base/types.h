@@ -29,8 +29,12 @@ typedef size_t size;
 // These are really handy. :)
 #if defined(__GNUC__) || defined(__clang__)
     #define assert(c) while (!(c)) __builtin_unreachable()
+    #define thread_local __thread
+    #define force_inline inline __attribute__((always_inline))
 #else
     #define assert(c)
+    #define thread_local
+    #define force_inline inline
 #endif
 
 #define countof(a)  (size)(sizeof(a) / sizeof(*(a)))
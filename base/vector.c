@@ -0,0 +1,89 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+void VECTOR_Initialize(segmented_vector_t* vector, arena_t* arena, uint32 element_size)
+{
+    vector->arena = arena;
+    vector->segments_len = 0;
+    vector->element_size = element_size;
+    vector->len = 0;
+}
+
+// Which segment an index is in. Segments 0..N hold FIRST * (2^(N+1) - 1)
+// elements together.
+static force_inline uint32 VECTOR_SegmentOf(uint32 index)
+{
+    uint32 scaled = (index >> VECTOR_FIRST_SEGMENT_SHIFT) + 1;
+    return 31 - __builtin_clz(scaled);
+}
+
+static force_inline uint32 VECTOR_SegmentStart(uint32 segment)
+{
+    return ((1u << segment) - 1) << VECTOR_FIRST_SEGMENT_SHIFT;
+}
+
+void* VECTOR_Push(segmented_vector_t* vector)
+{
+    uint32 index = vector->len;
+    uint32 segment = VECTOR_SegmentOf(index);
+
+    if (segment == vector->segments_len) {
+        assert(segment < VECTOR_SEGMENT_COUNT);
+        size segment_len = cast(size) VECTOR_FIRST_SEGMENT_LEN << segment;
+        vector->segments[segment] = ARENA_AllocNoZero(vector->arena, segment_len * vector->element_size);
+        if (!vector->segments[segment]) ARENA_ExitOutOfMemory();
+        vector->segments_len += 1;
+    }
+
+    vector->len += 1;
+    return vector->segments[segment] + (index - VECTOR_SegmentStart(segment)) * vector->element_size;
+}
+
+void* VECTOR_Get(segmented_vector_t* vector, uint32 index)
+{
+    assert(index < vector->len);
+    uint32 segment = VECTOR_SegmentOf(index);
+    return vector->segments[segment] + (index - VECTOR_SegmentStart(segment)) * vector->element_size;
+}
+
+// The element stays where it is until the next VECTOR_Push().
+void* VECTOR_Pop(segmented_vector_t* vector)
+{
+    assert(vector->len > 0);
+    void* element = VECTOR_Get(vector, vector->len - 1);
+    vector->len -= 1;
+    return element;
+}
+
+// Copies every element, in order, into one contiguous array.
+void VECTOR_CopyTo(segmented_vector_t* vector, void* destination)
+{
+    byte* cursor = destination;
+    for (uint32 segment = 0; segment < vector->segments_len; ++segment) {
+        uint32 start = VECTOR_SegmentStart(segment);
+        uint32 count = vector->len - start;
+        uint32 segment_len = VECTOR_FIRST_SEGMENT_LEN << segment;
+        if (count > segment_len) count = segment_len;
+
+        memcpy(cursor, vector->segments[segment], cast(size) count * vector->element_size);
+        cursor += cast(size) count * vector->element_size;
+    }
+}
@@ -0,0 +1,53 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+/// Segmented vector, like the SegmentedList in Zig's standard library.
+/// Elements live in segments that double in size, so appending never copies
+/// anything and pointers to elements stay valid for as long as the vector
+/// lives. Segments can come from any arena, even one that other allocations
+/// are interleaved with, such as a scratch arena.
+
+// Segment N holds VECTOR_FIRST_SEGMENT_LEN << N elements. With 28 of them,
+// every uint32 index fits.
+#define VECTOR_FIRST_SEGMENT_SHIFT 4
+#define VECTOR_FIRST_SEGMENT_LEN   (1u << VECTOR_FIRST_SEGMENT_SHIFT)
+#define VECTOR_SEGMENT_COUNT       28
+
+struct segmented_vector
+{
+    arena_t* arena;
+    byte* segments[VECTOR_SEGMENT_COUNT];
+    uint32 segments_len;
+    uint32 element_size;
+    uint32 len;
+};
+typedef struct segmented_vector segmented_vector_t;
+
+void VECTOR_Initialize(segmented_vector_t* vector, arena_t* arena, uint32 element_size);
+void* VECTOR_Push(segmented_vector_t* vector);
+void* VECTOR_Get(segmented_vector_t* vector, uint32 index);
+void* VECTOR_Pop(segmented_vector_t* vector);
+void VECTOR_CopyTo(segmented_vector_t* vector, void* destination);
+
+#endif // VECTOR_H
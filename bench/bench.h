@@ -0,0 +1,107 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+// Shared by every benchmark in this directory. Each one is built on its own
+// like main.c, by including the whole program in a single translation unit,
+// see `./build.sh bench`.
+
+// Needed for MAP_ANONYMOUS & co. under -std=c99.
+#define _DEFAULT_SOURCE
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "base/types.h"
+#include "base/cpu.h"
+#include "base/libc.h"
+#include "base/arena.h"
+#include "base/string.h"
+#include "base/number.h"
+#include "base/io.h"
+#include "base/intern.h"
+#include "base/vector.h"
+#include "base/trace.h"
+#include "base/thread.h"
+
+#include "lex.h"
+#include "ast.h"
+#include "error.h"
+#include "parse.h"
+
+#include "base/cpu.c"
+#include "base/arena.c"
+#include "base/string.c"
+#include "base/number.c"
+#include "base/io.c"
+#include "base/intern.c"
+#include "base/vector.c"
+#include "base/trace.c"
+#include "base/thread.c"
+#include "lex.c"
+#include "ast.c"
+#include "error.c"
+#include "parse.c"
+
+// Every measurement is repeated until it has run for at least this long.
+#define BENCH_MIN_SECONDS 0.1
+
+double BENCH_GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return cast(double) now.tv_sec + cast(double) now.tv_nsec / 1e9;
+}
+
+// Keeps the compiler from throwing away work whose result is never read.
+#define BENCH_Escape(ptr) __asm__ volatile("" : : "r"(ptr) : "memory")
+
+// Fills `data` with bytes from a fixed seed, so that runs are comparable.
+void BENCH_FillRandom(uint8* data, size len, uint32 seed)
+{
+    uint32 state = seed ? seed : 1;
+    for (size i = 0; i < len; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = cast(uint8) state;
+    }
+}
+
+#endif // BENCH_H
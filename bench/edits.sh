@@ -0,0 +1,44 @@
+#!/bin/sh
+
+# Replays edit sessions from tests/gen_edits.py and reports how long each edit
+# took to reparse, next to how long parsing the final text from scratch takes
+# with --full-reparse, which is what every edit would cost without the
+# document. Both as printed by --time:
+#   sample.l      tests/edits/sample.l, 20000 edits.
+#   functions.l   2000 small functions, 12K lines, 2000 edits.
+#
+# Usage: bench/edits.sh <lang binary, preferably built with ./build.sh release>
+
+LANG_BIN=$1
+TESTS=$(dirname "$0")/../tests
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$TESTS/edits/sample.l" "$TMP/sample.l"
+awk 'BEGIN {
+    for (i = 0; i < 2000; ++i) {
+        printf "fun f%d(a: int, b: int) -> int {\n", i
+        for (j = 0; j < 4; ++j) printf "    v%d := (a + %d) * b ^ c - d / %d;\n", j, i, j + 1
+        printf "}\n"
+    }
+}' > "$TMP/functions.l"
+python3 "$TESTS/gen_edits.py" "$TMP/sample.l" 20000 "$TMP/sample.edits" 6 || exit 1
+python3 "$TESTS/gen_edits.py" "$TMP/functions.l" 2000 "$TMP/functions.edits" 1 || exit 1
+
+# The sessions leave syntax errors behind, so exiting with 1 is expected. Only
+# the timings are printed, not the errors.
+FAILED=0
+for FILE in sample functions; do
+    for FLAGS in "" "--full-reparse"; do
+        echo "$FILE.l $FLAGS"
+        "$LANG_BIN" $FLAGS --time --edits "$TMP/$FILE.edits" "$TMP/$FILE.l" > /dev/null 2> "$TMP/time.out"
+        STATUS=$?
+        grep -E '^(lex|parse|edits|peak memory):' "$TMP/time.out" | sed 's/^/    /'
+        if [ $STATUS -gt 1 ]; then
+            echo "FAIL: exited with $STATUS"
+            FAILED=1
+        fi
+    done
+done
+
+exit $FAILED
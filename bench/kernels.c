@@ -0,0 +1,304 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Throughput of the memset(), memcpy(), memmove() and memcmp() kernels in
+// base/libc.h and of the arena allocation paths built on them.
+//
+// Every kernel is first checked against a plain byte loop on random offsets
+// and lengths, then timed at a range of sizes against that same byte loop.
+
+#include "bench.h"
+
+/* Byte loops, the reference for both correctness and speed */
+
+LIBC_FUNCTION void* BENCH_MemsetBytes(void* dest, int val, size len)
+{
+    uint8* d = dest;
+    for (size i = 0; i < len; ++i) d[i] = cast(uint8) val;
+    return dest;
+}
+
+LIBC_FUNCTION void* BENCH_CopyForwardBytes(void* dest, const void* src, size len)
+{
+    uint8* d = dest;
+    const uint8* s = src;
+    for (size i = 0; i < len; ++i) d[i] = s[i];
+    return dest;
+}
+
+LIBC_FUNCTION void* BENCH_CopyBackwardBytes(void* dest, const void* src, size len)
+{
+    uint8* d = dest;
+    const uint8* s = src;
+    while (len-- > 0) d[len] = s[len];
+    return dest;
+}
+
+LIBC_FUNCTION int BENCH_MemcmpBytes(const void* ptr1, const void* ptr2, size len)
+{
+    const uint8* p1 = ptr1;
+    const uint8* p2 = ptr2;
+    for (size i = 0; i < len; ++i) {
+        if (p1[i] != p2[i]) return p1[i] - p2[i];
+    }
+    return 0;
+}
+
+// What memmove() would do with these, so that the dispatched column measures
+// the same thing as the others.
+void* BENCH_CopyBackwardLibc(void* dest, const void* src, size len)
+{
+    return memmove(dest, src, len);
+}
+
+void* BENCH_MemsetLibc(void* dest, int val, size len) { return memset(dest, val, len); }
+void* BENCH_CopyForwardLibc(void* dest, const void* src, size len) { return memcpy(dest, src, len); }
+int BENCH_MemcmpLibc(const void* ptr1, const void* ptr2, size len) { return memcmp(ptr1, ptr2, len); }
+
+struct kernel_set
+{
+    const char* name;
+    uint features; // Needed to run it at all.
+    void* (*memset)(void*, int, size);
+    void* (*copy_forward)(void*, const void*, size);
+    void* (*copy_backward)(void*, const void*, size);
+    int (*memcmp)(const void*, const void*, size);
+};
+typedef struct kernel_set kernel_set_t;
+
+kernel_set_t kernel_sets[] = {
+    {"bytes", 0, BENCH_MemsetBytes, BENCH_CopyForwardBytes, BENCH_CopyBackwardBytes, BENCH_MemcmpBytes},
+    {"word", 0, LIBC_MemsetWord, LIBC_CopyForwardWord, LIBC_CopyBackwardWord, LIBC_MemcmpWord},
+#if CPU_X86
+    {"sse2", CPUF_SSE2, LIBC_MemsetSSE2, LIBC_CopyForwardSSE2, LIBC_CopyBackwardSSE2, LIBC_MemcmpSSE2},
+    {"avx2", CPUF_AVX2, LIBC_MemsetAVX2, LIBC_CopyForwardAVX2, LIBC_CopyBackwardAVX2, LIBC_MemcmpAVX2},
+#endif
+    {"dispatch", 0, BENCH_MemsetLibc, BENCH_CopyForwardLibc, BENCH_CopyBackwardLibc, BENCH_MemcmpLibc},
+};
+
+bool BENCH_CanRun(kernel_set_t* set)
+{
+    return (CPU_GetFeatures() & set->features) == set->features;
+}
+
+int BENCH_Sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+// Room for the largest size plus the offsets and overlaps used below.
+#define KERNEL_MAX_LEN   (cast(size) 1 << 20)
+#define KERNEL_BUFFER_LEN (KERNEL_MAX_LEN + 256)
+
+bool BENCH_CheckKernels(kernel_set_t* set, uint8* a, uint8* b, uint8* expected)
+{
+    uint32 state = 1;
+    for (uint iteration = 0; iteration < 100000; ++iteration) {
+        state = state * 1103515245 + 12345;
+        size from = (state >> 8) % 96;
+        size to = (state >> 16) % 96;
+        size len = (iteration * 7 + (state >> 24)) % 520;
+        int val = cast(int) (state >> 4);
+
+        BENCH_FillRandom(a, 640, iteration + 1);
+        BENCH_CopyForwardBytes(expected, a, 640);
+        BENCH_MemsetBytes(expected + from, val, len);
+        set->memset(a + from, val, len);
+        if (BENCH_MemcmpBytes(a, expected, 640) != 0) return false;
+
+        // Overlapping both ways, like memmove() hands them out.
+        BENCH_FillRandom(a, 640, iteration + 1);
+        BENCH_CopyForwardBytes(expected, a, 640);
+        if (to <= from) {
+            BENCH_CopyForwardBytes(expected + to, expected + from, len);
+            set->copy_forward(a + to, a + from, len);
+        } else {
+            BENCH_CopyBackwardBytes(expected + to, expected + from, len);
+            set->copy_backward(a + to, a + from, len);
+        }
+        if (BENCH_MemcmpBytes(a, expected, 640) != 0) return false;
+
+        BENCH_CopyForwardBytes(b, a, 640);
+        if (len > 0 && (state & 1)) b[from + (state >> 12) % len] ^= cast(uint8) (1 << (state >> 28) % 8);
+        if (BENCH_Sign(set->memcmp(a + from, b + from, len)) != BENCH_Sign(BENCH_MemcmpBytes(a + from, b + from, len))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+enum kernel_op
+{
+    KERNEL_OP_MEMSET,
+    KERNEL_OP_MEMCPY,
+    KERNEL_OP_MEMMOVE, // Overlapping, with the destination after the source.
+    KERNEL_OP_MEMCMP,  // Equal buffers, so that every byte is compared.
+};
+typedef enum kernel_op kernel_op_t;
+
+const char* kernel_op_names[] = {"memset", "memcpy", "memmove", "memcmp"};
+
+// In GB/s.
+double BENCH_TimeKernel(kernel_set_t* set, kernel_op_t op, size len, uint8* a, uint8* b)
+{
+    uint64 batch = (KERNEL_MAX_LEN / len) + 1;
+    uint64 runs = 0;
+    double start = BENCH_GetSeconds();
+    double elapsed = 0;
+    do {
+        for (uint64 i = 0; i < batch; ++i) {
+            switch (op) {
+                case KERNEL_OP_MEMSET:  set->memset(a, cast(int) i, len); break;
+                case KERNEL_OP_MEMCPY:  set->copy_forward(b, a, len); break;
+                case KERNEL_OP_MEMMOVE: set->copy_backward(a + 32, a, len); break;
+                case KERNEL_OP_MEMCMP:  if (set->memcmp(a, b, len) != 0) return 0; break;
+            }
+            BENCH_Escape(a);
+            BENCH_Escape(b);
+        }
+        runs += batch;
+        elapsed = BENCH_GetSeconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    return cast(double) (runs * len) / elapsed / 1e9;
+}
+
+void BENCH_Kernels(uint8* a, uint8* b)
+{
+    size lens[] = {16, 64, 256, 4 << 10, 64 << 10, 1 << 20};
+
+    for (uint op = KERNEL_OP_MEMSET; op <= KERNEL_OP_MEMCMP; ++op) {
+        printf("\n%-8s GB/s", kernel_op_names[op]);
+        for (size s = 0; s < countof(kernel_sets); ++s) {
+            if (BENCH_CanRun(&kernel_sets[s])) printf(" %9s", kernel_sets[s].name);
+        }
+        printf("\n");
+
+        for (size l = 0; l < countof(lens); ++l) {
+            printf("%10zu B  ", lens[l]);
+            for (size s = 0; s < countof(kernel_sets); ++s) {
+                if (!BENCH_CanRun(&kernel_sets[s])) continue;
+                BENCH_FillRandom(a, KERNEL_BUFFER_LEN, 1);
+                BENCH_FillRandom(b, KERNEL_BUFFER_LEN, 1);
+                printf(" %9.2f", BENCH_TimeKernel(&kernel_sets[s], op, lens[l], a, b));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+}
+
+// Allocates `len` bytes at a time until 64 MB are used, then rewinds. Returns
+// nanoseconds per allocation.
+double BENCH_ArenaAlloc(arena_t* arena, size len, bool zero)
+{
+    size per_round = (cast(size) 64 << 20) / len;
+    arena_temp_t temp = ARENA_TempBegin(arena);
+
+    uint64 allocs = 0;
+    double start = BENCH_GetSeconds();
+    double elapsed = 0;
+    do {
+        for (size i = 0; i < per_round; ++i) {
+            void* ptr = zero ? ARENA_Alloc(arena, len) : ARENA_AllocNoZero(arena, len);
+            BENCH_Escape(ptr);
+        }
+        allocs += per_round;
+        ARENA_TempEnd(temp);
+        elapsed = BENCH_GetSeconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    return elapsed * 1e9 / cast(double) allocs;
+}
+
+// Grows an array by doubling from 16 bytes to 1 MB, either in place as the
+// last allocation or with something allocated in between every time, which
+// forces a copy. Prints microseconds per array.
+void BENCH_ArenaResize(arena_t* arena, bool in_place)
+{
+    arena_temp_t temp = ARENA_TempBegin(arena);
+
+    uint64 arrays = 0;
+    double start = BENCH_GetSeconds();
+    double elapsed = 0;
+    do {
+        size len = 16;
+        uint8* data = ARENA_Alloc(arena, len);
+        for (; len < KERNEL_MAX_LEN; len *= 2) {
+            if (!in_place) BENCH_Escape(ARENA_AllocNoZero(arena, 16));
+            data = ARENA_Resize(arena, data, len, len * 2);
+            BENCH_Escape(data);
+        }
+        ++arrays;
+        ARENA_TempEnd(temp);
+        elapsed = BENCH_GetSeconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    printf("  %-10s %8.2f us per array\n", in_place ? "in place" : "copying",
+           elapsed * 1e6 / cast(double) arrays);
+}
+
+int main(void)
+{
+    uint8* a = malloc(KERNEL_BUFFER_LEN);
+    uint8* b = malloc(KERNEL_BUFFER_LEN);
+    uint8* expected = malloc(KERNEL_BUFFER_LEN);
+    if (!a || !b || !expected) return 1;
+
+    bool ok = true;
+    for (size s = 0; s < countof(kernel_sets); ++s) {
+        if (!BENCH_CanRun(&kernel_sets[s])) {
+            printf("skip: %s (not supported by this CPU)\n", kernel_sets[s].name);
+        } else if (BENCH_CheckKernels(&kernel_sets[s], a, b, expected)) {
+            printf("ok:   %s\n", kernel_sets[s].name);
+        } else {
+            printf("FAIL: %s\n", kernel_sets[s].name);
+            ok = false;
+        }
+    }
+    if (!ok) return 1;
+
+    BENCH_Kernels(a, b);
+
+    arena_t arena;
+    if (!ARENA_InitializeDefault(&arena)) return 1;
+    // Commits every page up front, so that page faults are not measured.
+    ARENA_Alloc(&arena, cast(size) 80 << 20);
+    ARENA_TempEnd((arena_temp_t) {&arena, 0, 0});
+
+    printf("\narena alloc   AllocNoZero          Alloc  (zeroing)\n");
+    size lens[] = {16, 256, 4 << 10, 64 << 10};
+    for (size l = 0; l < countof(lens); ++l) {
+        double no_zero = BENCH_ArenaAlloc(&arena, lens[l], false);
+        double zero = BENCH_ArenaAlloc(&arena, lens[l], true);
+        printf("%10zu B  %8.2f ns  %10.2f ns %7.2f GB/s\n", lens[l], no_zero, zero, cast(double) lens[l] / zero);
+    }
+
+    printf("\narena resize, 16 B to 1 MB\n");
+    BENCH_ArenaResize(&arena, true);
+    BENCH_ArenaResize(&arena, false);
+
+    ARENA_Release(&arena);
+    free(a);
+    free(b);
+    free(expected);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#!/bin/sh
+
+# Lexes and parses inputs far bigger or wider than real code and reports how
+# long that took and the peak memory, as printed by --time:
+#   statements.l   1.2M top-level statements.
+#   functions.l    300K small functions, 1.2M statements in their bodies.
+#   wide.l         100 functions with 10K parameters each.
+#   widest.l       One function with 500K parameters.
+# Each one runs with --threads 1, 2 and 4.
+#
+# Usage: bench/stress.sh <lang binary, preferably built with ./build.sh release>
+
+LANG_BIN=$1
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+awk 'BEGIN { for (i = 0; i < 1200000; ++i) printf "x%d := %d + y * (z - %d);\n", i, i, i % 7 }' > "$TMP/statements.l"
+awk 'BEGIN {
+    for (i = 0; i < 300000; ++i) {
+        printf "fun f%d(a: int, b: int) -> int {\n", i
+        for (j = 0; j < 4; ++j) printf "    v%d := (a + %d) * b ^ c - d / %d;\n", j, i, j + 1
+        printf "}\n"
+    }
+}' > "$TMP/functions.l"
+awk 'BEGIN {
+    for (i = 0; i < 100; ++i) {
+        printf "fun f%d(p0: t0", i
+        for (j = 1; j < 10000; ++j) printf ", p%d: t%d", j, j
+        printf ") -> int { r := p0 * %d; }\n", i
+    }
+}' > "$TMP/wide.l"
+awk 'BEGIN {
+    printf "fun f(p0: t0"
+    for (j = 1; j < 500000; ++j) printf ", p%d: t%d", j, j
+    printf ") -> int { r := p0; }\n"
+}' > "$TMP/widest.l"
+
+# Every file is also split between threads, to see how lexing and parsing
+# scale. More threads than cores only measures the overhead.
+echo "cores: $(getconf _NPROCESSORS_ONLN)"
+
+FAILED=0
+for FILE in statements.l functions.l wide.l widest.l; do
+    for FLAGS in "" "--lazy-bodies"; do
+        for THREADS in 1 2 4; do
+            echo "$FILE --threads $THREADS $FLAGS"
+            "$LANG_BIN" $FLAGS --threads $THREADS --time "$TMP/$FILE" > /dev/null 2> "$TMP/time.out"
+            STATUS=$?
+            sed 's/^/    /' "$TMP/time.out"
+            if [ $STATUS != 0 ]; then
+                echo "FAIL: exited with $STATUS"
+                FAILED=1
+            fi
+        done
+    done
+done
+
+exit $FAILED
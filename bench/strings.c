@@ -0,0 +1,382 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Throughput of the string kernels in base/string.c, scalar and vectorized,
+// and of the lexer that is built on them.
+//
+// The kernels are checked against STRING_IsInClass() on random input first.
+// Telling keywords from identifiers is timed on its own, the old way and
+// with the perfect hash. The lexer runs on a generated corpus (or the file
+// given as the only argument) and on an identifier- and keyword-dense one,
+// with the vector kernels and again without, like --no-simd.
+
+#include "bench.h"
+
+struct string_kernels
+{
+    const char* name;
+    uint features; // Needed to run them at all.
+    size (*find_byte)(const uint8*, size, size, uint8);
+    size (*skip_class)(const uint8*, size, size, char_class_t);
+};
+typedef struct string_kernels string_kernels_t;
+
+string_kernels_t string_kernels[] = {
+    {"scalar", 0, STRING_FindByteScalar, STRING_SkipClassScalar},
+#if CPU_X86
+    {"sse2", CPUF_SSE2, STRING_FindByteSSE2, STRING_SkipClassSSE2},
+    {"avx2", CPUF_AVX2, STRING_FindByteAVX2, STRING_SkipClassAVX2},
+#endif
+};
+
+const char* char_class_names[] = {
+    [CHAR_CLASS_DIGIT] = "digit",
+    [CHAR_CLASS_NUMBER] = "number",
+    [CHAR_CLASS_IDENTIFIER] = "identifier",
+    [CHAR_CLASS_WHITESPACE] = "whitespace",
+};
+
+// Bytes that each class is made of, for filling buffers with long runs.
+const char* char_class_members[] = {
+    [CHAR_CLASS_DIGIT] = "0123456789",
+    [CHAR_CLASS_NUMBER] = "0123456789.",
+    [CHAR_CLASS_IDENTIFIER] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_",
+    [CHAR_CLASS_WHITESPACE] = " \t\r\n",
+};
+
+bool BENCH_CanRun(string_kernels_t* kernels)
+{
+    return (CPU_GetFeatures() & kernels->features) == kernels->features;
+}
+
+#define STRING_MAX_LEN    (cast(size) 64 << 10)
+#define STRING_BUFFER_LEN (STRING_MAX_LEN + 64)
+
+bool BENCH_CheckKernels(string_kernels_t* kernels, uint8* data)
+{
+    // Mostly members of the class, so that runs are long enough to cross
+    // vector boundaries.
+    uint32 state = 1;
+    for (uint iteration = 0; iteration < 20000; ++iteration) {
+        char_class_t class = iteration % 4;
+        const char* members = char_class_members[class];
+        size members_len = STRING_FromCString(members).len;
+
+        size len = iteration % 300;
+        for (size i = 0; i < len; ++i) {
+            state = state * 1103515245 + 12345;
+            data[i] = (state >> 24) < 16 ? cast(uint8) (state >> 16) : cast(uint8) members[(state >> 16) % members_len];
+        }
+        size from = len > 0 ? (state >> 8) % len : 0;
+
+        size expected = from;
+        while (expected < len && STRING_IsInClass(data[expected], class)) ++expected;
+        if (kernels->skip_class(data, from, len, class) != expected) return false;
+
+        uint8 c = len > 0 ? data[len - 1] : 0;
+        expected = from;
+        while (expected < len && data[expected] != c) ++expected;
+        if (kernels->find_byte(data, from, len, c) != expected) return false;
+    }
+    return true;
+}
+
+// Runs `len` bytes of a single class (or of a byte that is never found) at a
+// time, so that every kernel call scans all of them. In GB/s.
+double BENCH_TimeKernel(string_kernels_t* kernels, int class, size len, uint8* data)
+{
+    uint64 batch = (STRING_MAX_LEN / len) + 1;
+    uint64 runs = 0;
+    double start = BENCH_GetSeconds();
+    double elapsed = 0;
+    do {
+        for (uint64 i = 0; i < batch; ++i) {
+            size end = class < 0 ? kernels->find_byte(data, 0, len, '\n') : kernels->skip_class(data, 0, len, class);
+            if (end != len) return 0;
+            BENCH_Escape(data);
+        }
+        runs += batch;
+        elapsed = BENCH_GetSeconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    return cast(double) (runs * len) / elapsed / 1e9;
+}
+
+void BENCH_Kernels(uint8* data)
+{
+    size lens[] = {8, 16, 64, 256, 4 << 10, 64 << 10};
+
+    // -1 is STRING_FindByte(), the rest are the classes.
+    for (int class = -1; class <= CHAR_CLASS_WHITESPACE; ++class) {
+        if (class < 0) {
+            memset(data, 'a', STRING_BUFFER_LEN);
+            printf("\n%-10s GB/s", "find byte");
+        } else {
+            const char* members = char_class_members[class];
+            size members_len = STRING_FromCString(members).len;
+            for (size i = 0; i < STRING_BUFFER_LEN; ++i) data[i] = cast(uint8) members[i % members_len];
+            printf("\n%-10s GB/s", char_class_names[class]);
+        }
+        for (size k = 0; k < countof(string_kernels); ++k) {
+            if (BENCH_CanRun(&string_kernels[k])) printf(" %9s", string_kernels[k].name);
+        }
+        printf("\n");
+
+        for (size l = 0; l < countof(lens); ++l) {
+            printf("%10zu B    ", lens[l]);
+            for (size k = 0; k < countof(string_kernels); ++k) {
+                if (!BENCH_CanRun(&string_kernels[k])) continue;
+                printf(" %9.2f", BENCH_TimeKernel(&string_kernels[k], class, lens[l], data));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+}
+
+// STRING_Equals() on equal strings and STRING_Hash(). In GB/s.
+void BENCH_EqualsAndHash(uint8* data)
+{
+    size lens[] = {8, 16, 64, 256, 4 << 10};
+    BENCH_FillRandom(data, STRING_BUFFER_LEN, 1);
+
+    printf("\n%-15s %9s %9s\n", "GB/s", "equals", "hash");
+    for (size l = 0; l < countof(lens); ++l) {
+        string_t a = STRING_SIZED(data, lens[l]);
+        string_t b = STRING_SIZED(data + STRING_MAX_LEN / 2, lens[l]);
+        memcpy(b.data, a.data, b.len);
+
+        double gbs[2];
+        for (uint which = 0; which < 2; ++which) {
+            uint64 batch = (STRING_MAX_LEN / lens[l]) + 1;
+            uint64 runs = 0;
+            uint64 sink = 0;
+            double start = BENCH_GetSeconds();
+            double elapsed = 0;
+            do {
+                for (uint64 i = 0; i < batch; ++i) {
+                    sink += which == 0 ? STRING_Equals(&a, &b) : STRING_Hash(a);
+                    BENCH_Escape(data);
+                }
+                runs += batch;
+                elapsed = BENCH_GetSeconds() - start;
+            } while (elapsed < BENCH_MIN_SECONDS);
+            BENCH_Escape(&sink);
+            gbs[which] = cast(double) (runs * lens[l]) / elapsed / 1e9;
+        }
+        printf("%10zu B    %9.2f %9.2f\n", lens[l], gbs[0], gbs[1]);
+    }
+}
+
+// About this much code, made of the usual mix of declarations and
+// expressions with identifiers and numbers of varying length.
+#define LEXER_CORPUS_SIZE (cast(size) 32 << 20)
+
+string_t BENCH_GenerateCorpus(void)
+{
+    static const char* lines[] = {
+        "fun function_%u(left: int, right_side: float, count: int) -> int {\n",
+        "    value_%u := (left + %u) * right_side ^ 2 - count / 3.25;\n",
+        "    fun inner(q: int) -> int { r := q * %u; }\n",
+        "    accumulated_total_%u := accumulated_total + 1234567 * x;\n",
+        "}\n",
+        "global_%u := %u + y * (z - 42);\n",
+        "\n",
+    };
+
+    uint8* data = malloc(LEXER_CORPUS_SIZE + 256 + IO_SOURCE_PADDING);
+    if (!data) return STRING_SIZED(null, 0);
+
+    size len = 0;
+    for (uint i = 0; len < LEXER_CORPUS_SIZE; ++i) {
+        len += cast(size) sprintf(cast(char*) data + len, lines[i % countof(lines)], i, i % 1000);
+    }
+    memset(data + len, 0, IO_SOURCE_PADDING);
+    return STRING_SIZED(data, len);
+}
+
+// Identifier-dense source: words separated by single spaces, 30% of them
+// keywords, the rest drawn from a few thousand distinct identifiers. Fills
+// `words` with views of them, for BENCH_Keywords().
+#define WORDS_LEN       600000
+#define WORDS_VOCABULARY 5000
+
+string_t keyword_spellings[] = {
+#define X(kind, spelling, first, last, name) STRING(spelling),
+    KEYWORDS(X)
+#undef X
+};
+
+string_t BENCH_GenerateWords(string_t* words)
+{
+    static const char* stems[] = {"x", "value", "count", "node_index", "accumulated_total", "parseExpressionList"};
+
+    uint8* data = malloc(WORDS_LEN * 32 + IO_SOURCE_PADDING);
+    if (!data) return STRING_SIZED(null, 0);
+
+    size len = 0;
+    uint32 state = 1;
+    for (uint i = 0; i < WORDS_LEN; ++i) {
+        state = state * 1103515245 + 12345;
+        uint8* word = data + len;
+        if ((state >> 16) % 10 < 3) {
+            string_t keyword = keyword_spellings[(state >> 8) % countof(keyword_spellings)];
+            memcpy(word, keyword.data, keyword.len);
+            len += keyword.len;
+        } else {
+            uint identifier = (state >> 8) % WORDS_VOCABULARY;
+            len += cast(size) sprintf(cast(char*) word, "%s%u", stems[identifier % countof(stems)], identifier);
+        }
+        words[i] = STRING_SIZED(word, cast(size) (data + len - word));
+        data[len++] = (i % 10 == 9) ? '\n' : ' ';
+    }
+    memset(data + len, 0, IO_SOURCE_PADDING);
+    return STRING_SIZED(data, len);
+}
+
+// Telling keywords from identifiers, the way the lexer did before the
+// perfect hash (interning every word into a table that starts with the
+// keywords, then checking the symbol) and the way it does now. In ns/word.
+void BENCH_Keywords(string_t* words)
+{
+    printf("\nkeywords, %u words       ns/word\n", WORDS_LEN);
+    for (uint which = 0; which < 2; ++which) {
+        double best = 0;
+        uint64 keywords = 0;
+        for (uint run = 0; run < 3; ++run) {
+            intern_table_t table;
+            INTERN_Initialize(&table);
+            for (size k = 0; k < countof(keyword_spellings); ++k) INTERN_InternView(&table, keyword_spellings[k]);
+
+            keywords = 0;
+            double start = BENCH_GetSeconds();
+            for (uint i = 0; i < WORDS_LEN; ++i) {
+                string_t word = words[i];
+                if (which == 0) {
+                    keywords += INTERN_InternView(&table, word) <= countof(keyword_spellings);
+                } else {
+                    const struct keyword* keyword = &keyword_table[KEYWORD_HASH(word.len, word.data[0], word.data[word.len-1])];
+                    keywords += keyword->name.len == word.len && STRING_Equals(&keyword->name, &word);
+                }
+            }
+            double elapsed = BENCH_GetSeconds() - start;
+            BENCH_Escape(&keywords);
+
+            INTERN_Release(&table);
+            if (run == 0 || elapsed < best) best = elapsed;
+        }
+        printf("  %-22s %8.2f  (%lu keywords)\n", which == 0 ? "intern, symbol range" : "perfect hash",
+               best * 1e9 / WORDS_LEN, cast(unsigned long) keywords);
+    }
+}
+
+// Lexes `code` on one thread, best of three. Returns the token count.
+uint32 BENCH_Lexer(string_t code, const char* corpus, const char* kernels)
+{
+    double best = 0;
+    uint32 tokens_len = 0;
+    for (uint run = 0; run < 3; ++run) {
+        double start = BENCH_GetSeconds();
+        lexer_t lexer = LEXER_Create(code);
+        token_buffer_t tokens = LEXER_Tokenize(&lexer);
+        double elapsed = BENCH_GetSeconds() - start;
+
+        tokens_len = tokens.len;
+        TOKEN_ReleaseBuffer(&tokens);
+        LEXER_Destroy(&lexer);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+
+    printf("  %-8s %-7s %8.1f MB/s %8.2f Mtokens/s  (%u tokens, %.1f MB)\n", corpus, kernels,
+           cast(double) code.len / best / 1e6, cast(double) tokens_len / best / 1e6,
+           tokens_len, cast(double) code.len / 1e6);
+    return tokens_len;
+}
+
+int main(int argc, char** argv)
+{
+    uint8* data = malloc(STRING_BUFFER_LEN);
+    if (!data) return 1;
+
+    bool ok = true;
+    for (size k = 0; k < countof(string_kernels); ++k) {
+        if (!BENCH_CanRun(&string_kernels[k])) {
+            printf("skip: %s (not supported by this CPU)\n", string_kernels[k].name);
+        } else if (BENCH_CheckKernels(&string_kernels[k], data)) {
+            printf("ok:   %s\n", string_kernels[k].name);
+        } else {
+            printf("FAIL: %s\n", string_kernels[k].name);
+            ok = false;
+        }
+    }
+    if (!ok) return 1;
+
+    BENCH_Kernels(data);
+    BENCH_EqualsAndHash(data);
+    free(data);
+
+    string_t* words = malloc(WORDS_LEN * sizeof(string_t));
+    if (!words) return 1;
+    string_t corpora[2];
+    const char* corpus_names[2] = {"mixed", "words"};
+    uint corpora_len = 2;
+    corpora[1] = BENCH_GenerateWords(words);
+    if (!corpora[1].data) return 1;
+    BENCH_Keywords(words);
+
+    io_file_t file = {0};
+    if (argc > 1) {
+        file = IO_OpenFile(argv[1]);
+        if (file.error != IO_ERROR_NONE) {
+            fprintf(stderr, "error: %s '%s'.\n", io_error_names[file.error], argv[1]);
+            return 1;
+        }
+        if (file.contents.len > LEXER_MAX_SOURCE_SIZE) {
+            fprintf(stderr, "error: '%s' is too big to lex.\n", argv[1]);
+            return 1;
+        }
+        corpora[0] = file.contents;
+        corpus_names[0] = "file";
+    } else {
+        corpora[0] = BENCH_GenerateCorpus();
+        if (!corpora[0].data) return 1;
+    }
+
+    printf("\nlexer, one thread\n");
+    uint32 tokens_lens[2];
+    for (uint c = 0; c < corpora_len; ++c) tokens_lens[c] = BENCH_Lexer(corpora[c], corpus_names[c], "vector");
+    CPU_DisableFeatures(CPUF_SSE2 | CPUF_AVX2);
+    LIBC_Resolve();
+    STRING_ResolveKernels();
+    for (uint c = 0; c < corpora_len; ++c) {
+        uint32 scalar_tokens = BENCH_Lexer(corpora[c], corpus_names[c], "scalar");
+        if (scalar_tokens != tokens_lens[c]) {
+            printf("FAIL: the scalar lexer found %u tokens rather than %u\n", scalar_tokens, tokens_lens[c]);
+            return 1;
+        }
+    }
+
+    if (argc > 1) IO_CloseFile(&file);
+    else free(corpora[0].data);
+    free(corpora[1].data);
+    free(words);
+    return 0;
+}
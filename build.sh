@@ -1,17 +1,56 @@
 #!/bin/sh
 
-# @TODO: separate debug & build
+# Usage: ./build.sh [release|test|bench]
+#   test: builds like the default and runs every tests/*.sh against it.
+#   bench: builds like release, then builds and runs every bench/*.c and runs
+#          every bench/*.sh against the release binary.
 # @TODO: add support for clang
 # - Try adding -fsanitize-trap as well.
 
-COMPILER_FLAGS="-O0 -std=c99 -ggdb3 -Wall -Wno-unused-variable -Wno-discarded-qualifiers"
-SANITIZER_FLAGS="-fsanitize=undefined"
+if [ "$1" = "release" ] || [ "$1" = "bench" ]; then
+    COMPILER_FLAGS="-O2 -std=c99 -Wall -Wno-unused-variable -Wno-discarded-qualifiers"
+    SANITIZER_FLAGS=""
+    DEFINE_FLAGS=""
+else
+    COMPILER_FLAGS="-O0 -std=c99 -ggdb3 -Wall -Wno-unused-variable -Wno-discarded-qualifiers"
+    SANITIZER_FLAGS="-fsanitize=undefined"
+    DEFINE_FLAGS="-DARENA_STATS=1 -DTRACE_ENABLED=1"
+fi
 INCLUDE_FLAGS="-Isrc"
+LINKER_FLAGS="-pthread"
 
 set -x
-time gcc $INCLUDE_FLAGS $COMPILER_FLAGS $SANITIZER_FLAGS main.c -o lang || exit 1
+time gcc $INCLUDE_FLAGS $COMPILER_FLAGS $SANITIZER_FLAGS $DEFINE_FLAGS main.c -o lang $LINKER_FLAGS || exit 1
 set +x
 
+if [ "$1" = "test" ]; then
+    FAILED=0
+    for TEST in tests/*.sh; do
+        echo
+        echo "$TEST"
+        sh "$TEST" ./lang || FAILED=1
+    done
+    [ $FAILED = 0 ] || exit 1
+fi
+
+if [ "$1" = "bench" ]; then
+    BENCH_DIR=$(mktemp -d) || exit 1
+    trap 'rm -rf "$BENCH_DIR"' EXIT
+    for BENCH in bench/*.c; do
+        NAME=$(basename "$BENCH" .c)
+        echo
+        echo "$BENCH"
+        gcc -I. $INCLUDE_FLAGS $COMPILER_FLAGS $DEFINE_FLAGS "$BENCH" -o "$BENCH_DIR/$NAME" $LINKER_FLAGS || exit 1
+        "$BENCH_DIR/$NAME" || exit 1
+    done
+    for BENCH in bench/*.sh; do
+        [ -e "$BENCH" ] || continue
+        echo
+        echo "$BENCH"
+        sh "$BENCH" ./lang || exit 1
+    done
+fi
+
 echo
 echo "All done."
 echo "========="
@@ -19,43 +19,378 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+// Needed for MAP_ANONYMOUS & co. under -std=c99.
+#define _DEFAULT_SOURCE
+
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include "base/types.h"
+#include "base/cpu.h"
 #include "base/libc.h"
 #include "base/arena.h"
 #include "base/string.h"
+#include "base/number.h"
 #include "base/io.h"
+#include "base/intern.h"
+#include "base/vector.h"
+#include "base/trace.h"
+#include "base/thread.h"
 
 #include "lex.h"
 #include "ast.h"
 #include "error.h"
 #include "parse.h"
+#include "document.h"
 
+#include "base/cpu.c"
 #include "base/arena.c"
 #include "base/string.c"
+#include "base/number.c"
 #include "base/io.c"
+#include "base/intern.c"
+#include "base/vector.c"
+#include "base/trace.c"
+#include "base/thread.c"
 #include "lex.c"
 #include "ast.c"
 #include "error.c"
 #include "parse.c"
+#include "document.c"
 
-int main(int argc, char** argv)
+void PrintUsage(void)
 {
-    if (argc != 2) {
-        printf("usage: ./lang <filename>\n");
-        return 1;
+    printf("usage: ./lang [options] <filename>\n");
+    printf("    Use - as the filename to read from stdin.\n");
+    printf("options:\n");
+    printf("    --mem-stats    print arena usage statistics to stderr\n");
+    printf("    --no-simd      use the scalar kernels only\n");
+    printf("    --lazy-bodies  only parse function bodies when something reads them\n");
+    printf("    --time         print how long lexing and parsing took, and peak memory, to stderr\n");
+    printf("    --threads <n>  lex and parse large files on up to n threads (default: one per CPU)\n");
+    printf("    --edits <file> replay the edits in file, parsing again only what they change\n");
+    printf("    --full-reparse apply the edits to the text and parse the result from scratch instead\n");
+    printf("    --dump-tokens  print every token\n");
+    printf("    --dump-ast     print the syntax tree\n");
+    printf("    --trace-parse[=verbose]\n");
+    printf("                   print what the parser parses\n");
+}
+
+void EnableTrace(trace_category_t category, trace_level_t level, const char* flag)
+{
+#if TRACE_ENABLED
+    TRACE_SetLevel(category, level);
+#else
+    fprintf(stderr, "warning: tracing is compiled out of this build, %s does nothing.\n", flag);
+#endif
+}
+
+// Reads the next edit of a session file. Each one is a line with the start
+// and end of the bytes it replaces and the length of the text replacing them,
+// then that many bytes of text and a newline.
+bool ReadEdit(string_t session, size* at, text_edit_t* edit)
+{
+    uint64 numbers[3];
+    size i = *at;
+    for (uint n = 0; n < 3; ++n) {
+        if (i >= session.len || session.data[i] < '0' || session.data[i] > '9') return false;
+
+        numbers[n] = 0;
+        while (i < session.len && session.data[i] >= '0' && session.data[i] <= '9') {
+            numbers[n] = numbers[n] * 10 + (session.data[i++] - '0');
+            if (numbers[n] > UINT32_MAX) return false;
+        }
+
+        char separator = n < 2 ? ' ' : '\n';
+        if (i >= session.len || session.data[i++] != separator) return false;
+    }
+
+    if (numbers[2] + 1 > session.len - i || session.data[i + numbers[2]] != '\n') return false;
+
+    edit->start = cast(uint32) numbers[0];
+    edit->end = cast(uint32) numbers[1];
+    edit->text = STRING_SIZED(session.data + i, numbers[2]);
+    *at = i + numbers[2] + 1;
+    return true;
+}
+
+double GetSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return cast(double) now.tv_sec + cast(double) now.tv_nsec / 1e9;
+}
+
+// Whether an edit is within a text of `len` bytes, and keeps it small enough
+// to lex.
+bool CheckEdit(text_edit_t edit, size len)
+{
+    return edit.start <= edit.end && edit.end <= len
+        && len - (edit.end - edit.start) + edit.text.len <= LEXER_MAX_SOURCE_SIZE;
+}
+
+// Applies every edit in the session to a copy of `code` in `arena`, for
+// --full-reparse.
+bool ApplyEdits(string_t* code, string_t session, const char* name, arena_t* arena)
+{
+    // Checked all up front, so that the copy is allocated once.
+    size len = code->len;
+    size cap = len;
+    uint32 edits_len = 0;
+    text_edit_t edit;
+    for (size at = 0; at < session.len; ++edits_len) {
+        if (!ReadEdit(session, &at, &edit) || !CheckEdit(edit, len)) {
+            fprintf(stderr, "error: edit %u in '%s' is malformed or out of range.\n", edits_len + 1, name);
+            return false;
+        }
+        len = len - (edit.end - edit.start) + edit.text.len;
+        if (len > cap) cap = len;
     }
 
-    string_t code = IO_ReadFileFromPath(argv[1]);
+    uint8* text = null;
+    if (ARENA_InitializeVirtual(arena, cap + IO_SOURCE_PADDING)) text = ARENA_Alloc(arena, cap + IO_SOURCE_PADDING);
+    if (!text) {
+        fprintf(stderr, "error: ran out of memory applying the edits in '%s'.\n", name);
+        return false;
+    }
+    memcpy(text, code->data, code->len);
+
+    len = code->len;
+    for (size at = 0; at < session.len;) {
+        ReadEdit(session, &at, &edit);
+        memmove(text + edit.start + edit.text.len, text + edit.end, len - edit.end);
+        memcpy(text + edit.start, edit.text.data, edit.text.len);
+        len = len - (edit.end - edit.start) + edit.text.len;
+        memset(text + len, 0, IO_SOURCE_PADDING);
+    }
+
+    *code = STRING_SIZED(text, len);
+    return true;
+}
+
+void ParseFile(string_t code, bool lazy_bodies, uint thread_count, bool print_times, bool print_mem_stats)
+{
+    double lex_start = GetSeconds();
     lexer_t lexer = LEXER_Create(code);
-    parser_t parser = PARSER_Create(&lexer);
-    PARSER_Parse(&parser);
+    token_buffer_t tokens = LEXER_TokenizeParallel(&lexer, thread_count);
+    if (TRACE_IS_ENABLED(TRACE_LEX, TRACE_LEVEL_INFO)) TOKEN_DumpBuffer(&tokens);
+
+    double parse_start = GetSeconds();
+    parser_t parser = PARSER_Create(&lexer, &tokens);
+    parser.lazy_bodies = lazy_bodies;
+    PARSER_ParseParallel(&parser, thread_count);
+    double parse_end = GetSeconds();
+
+    if (print_times) {
+        fprintf(stderr, "lex:   %8.3f ms (%u tokens, %zu bytes)\n", (parse_start - lex_start) * 1e3, tokens.len, code.len);
+        fprintf(stderr, "parse: %8.3f ms\n", (parse_end - parse_start) * 1e3);
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            fprintf(stderr, "peak memory: %ld KB\n", usage.ru_maxrss);
+        }
+    }
+
+    if (print_mem_stats) {
+        ARENA_DumpStats(&lexer.literal_arena, "literal");
+        ARENA_DumpStats(&tokens.arena, "token");
+        ARENA_DumpStats(&parser.ast.kinds_arena, "node kinds");
+        ARENA_DumpStats(&parser.ast.tokens_arena, "node tokens");
+        ARENA_DumpStats(&parser.ast.lhs_arena, "node lhs");
+        ARENA_DumpStats(&parser.ast.rhs_arena, "node rhs");
+        ARENA_DumpStats(&parser.ast.extra_arena, "node extra");
+        ARENA_DumpScratchStats();
+    }
+
+    TRACE_Flush();
     PARSER_Destroy(&parser);
+    TOKEN_ReleaseBuffer(&tokens);
+}
+
+// Parses `code` once, then replays the session on it edit by edit. Errors
+// and dumps are only printed for the final text.
+bool EditDocument(string_t code, string_t session, const char* name, bool lazy_bodies, uint thread_count,
+                  bool print_times, bool print_mem_stats)
+{
+    double parse_start = GetSeconds();
+    document_t document;
+    DOCUMENT_Initialize(&document, code, lazy_bodies, thread_count);
+    double parse_end = GetSeconds();
+
+    uint32 edits_len = 0;
+    double edits_time = 0;
+    double slowest = 0;
+    text_edit_t edit;
+    for (size at = 0; at < session.len; ++edits_len) {
+        if (!ReadEdit(session, &at, &edit) || !CheckEdit(edit, document.len)) {
+            fprintf(stderr, "error: edit %u in '%s' is malformed or out of range.\n", edits_len + 1, name);
+            DOCUMENT_Release(&document);
+            return false;
+        }
+
+        double edit_start = GetSeconds();
+        DOCUMENT_ApplyEdit(&document, edit);
+        double seconds = GetSeconds() - edit_start;
+
+        edits_time += seconds;
+        if (seconds > slowest) slowest = seconds;
+    }
+
+    DOCUMENT_ReportErrors(&document);
+    if (TRACE_IS_ENABLED(TRACE_LEX, TRACE_LEVEL_INFO)) DOCUMENT_DumpTokens(&document);
+    if (TRACE_IS_ENABLED(TRACE_AST, TRACE_LEVEL_INFO)) DOCUMENT_DumpAST(&document);
+
+    if (print_times) {
+        fprintf(stderr, "parse: %8.3f ms (%zu bytes)\n", (parse_end - parse_start) * 1e3, code.len);
+        fprintf(stderr, "edits: %8.3f ms (%u edits, %.3f ms on average, %.3f ms at most)\n", edits_time * 1e3,
+                edits_len, edits_len > 0 ? edits_time * 1e3 / edits_len : 0.0, slowest * 1e3);
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            fprintf(stderr, "peak memory: %ld KB\n", usage.ru_maxrss);
+        }
+    }
+
+    if (print_mem_stats) {
+        fprintf(stderr, "document: %u statements, %u nodes (%u live), %u symbols, %u compactions\n",
+                document.statements_len, document.parser.ast.len - 1, document.live_nodes,
+                document.lexer.symbols.strings_len - 1, document.compactions);
+        ARENA_DumpStats(&document.lexer.literal_arena, "literal");
+        ARENA_DumpStats(&document.tokens.arena, "token");
+        ARENA_DumpStats(&document.parser.ast.kinds_arena, "node kinds");
+        ARENA_DumpStats(&document.parser.ast.extra_arena, "node extra");
+        ARENA_DumpStats(&document.text_arena, "edited text");
+        ARENA_DumpStats(&document.statements_arena, "statements");
+        ARENA_DumpScratchStats();
+    }
+
+    TRACE_Flush();
+    DOCUMENT_Release(&document);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filename = null;
+    const char* edits_filename = null;
+    bool print_mem_stats = false;
+    bool print_times = false;
+    bool lazy_bodies = false;
+    bool full_reparse = false;
+    uint thread_count = THREAD_GetCPUCount();
+
+    // Resolved lazily they would be written by whichever thread first calls
+    // them, while other threads read them. Do it before there are any.
+    CPU_GetFeatures();
+    LIBC_Resolve();
+    STRING_ResolveKernels();
+
+    for (int i = 1; i < argc; ++i) {
+        string_t arg = STRING_FromCString(argv[i]);
+        if (STRING_Equals(&arg, &STRING("--mem-stats"))) {
+            print_mem_stats = true;
+        } else if (STRING_Equals(&arg, &STRING("--lazy-bodies"))) {
+            lazy_bodies = true;
+        } else if (STRING_Equals(&arg, &STRING("--time"))) {
+            print_times = true;
+        } else if (STRING_Equals(&arg, &STRING("--threads")) && i + 1 < argc) {
+            string_t count = STRING_FromCString(argv[++i]);
+            thread_count = 0;
+            for (size c = 0; c < count.len; ++c) {
+                if (count.data[c] < '0' || count.data[c] > '9' || thread_count > LEXER_MAX_THREADS) {
+                    thread_count = 0;
+                    break;
+                }
+                thread_count = thread_count * 10 + (count.data[c] - '0');
+            }
+            if (thread_count == 0 || thread_count > LEXER_MAX_THREADS) {
+                fprintf(stderr, "error: --threads expects a number from 1 to %d.\n", LEXER_MAX_THREADS);
+                return 1;
+            }
+        } else if (STRING_Equals(&arg, &STRING("--edits")) && i + 1 < argc) {
+            edits_filename = argv[++i];
+        } else if (STRING_Equals(&arg, &STRING("--full-reparse"))) {
+            full_reparse = true;
+        } else if (STRING_Equals(&arg, &STRING("--dump-tokens"))) {
+            EnableTrace(TRACE_LEX, TRACE_LEVEL_INFO, argv[i]);
+        } else if (STRING_Equals(&arg, &STRING("--dump-ast"))) {
+            EnableTrace(TRACE_AST, TRACE_LEVEL_INFO, argv[i]);
+        } else if (STRING_Equals(&arg, &STRING("--trace-parse"))) {
+            EnableTrace(TRACE_PARSE, TRACE_LEVEL_INFO, argv[i]);
+        } else if (STRING_Equals(&arg, &STRING("--trace-parse=verbose"))) {
+            EnableTrace(TRACE_PARSE, TRACE_LEVEL_VERBOSE, argv[i]);
+        } else if (STRING_Equals(&arg, &STRING("--no-simd"))) {
+            CPU_DisableFeatures(CPUF_SSE2 | CPUF_AVX2);
+            LIBC_Resolve();
+            STRING_ResolveKernels();
+        } else if (filename == null && (STRING_Equals(&arg, &STRING("-")) || (arg.len > 0 && arg.data[0] != '-'))) {
+            filename = argv[i];
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (filename == null) {
+        PrintUsage();
+        return 1;
+    }
+
+    io_file_t file = IO_OpenFile(filename);
+    if (file.error != IO_ERROR_NONE) {
+        fprintf(stderr, "error: %s '%s' (errno %d).\n", io_error_names[file.error], filename, file.error_number);
+        return 1;
+    }
+    if (file.contents.len > LEXER_MAX_SOURCE_SIZE) {
+        fprintf(stderr, "error: '%s' is %zu bytes, files can be at most %zu bytes.\n", filename, file.contents.len,
+                LEXER_MAX_SOURCE_SIZE);
+        return 1;
+    }
+
+    string_t code = file.contents;
+    arena_t edited_arena;
+    ARENA_Initialize(&edited_arena, null, 0);
+
+    if (edits_filename != null) {
+        io_file_t session = IO_OpenFile(edits_filename);
+        if (session.error != IO_ERROR_NONE) {
+            fprintf(stderr, "error: %s '%s' (errno %d).\n", io_error_names[session.error], edits_filename, session.error_number);
+            return 1;
+        }
+
+        bool replayed = full_reparse
+            ? ApplyEdits(&code, session.contents, edits_filename, &edited_arena)
+            : EditDocument(code, session.contents, edits_filename, lazy_bodies, thread_count, print_times, print_mem_stats);
+        IO_CloseFile(&session);
+        if (!replayed) return 1;
+    }
+
+    if (edits_filename == null || full_reparse) {
+        ParseFile(code, lazy_bodies, thread_count, print_times, print_mem_stats);
+    }
+    ARENA_Release(&edited_arena);
+    IO_CloseFile(&file);
+
+    uint32 error_count = ERROR_GetCount();
+    if (error_count > 0) {
+        fprintf(stderr, "%u error%s.\n", error_count, error_count == 1 ? "" : "s");
+        return 1;
+    }
     return 0;
 }
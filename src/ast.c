@@ -19,26 +19,268 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-#define AST_CREATE_NODE(arena)           ARENA_Alloc(arena, sizeof(ast_node_t))
-#define AST_CREATE_NODE_SIZED(arena, sz) ARENA_Alloc(arena, sz)
+void AST_Initialize(ast_t* ast)
+{
+    bool reserved = ARENA_InitializeDefault(&ast->kinds_arena)
+        && ARENA_InitializeDefault(&ast->tokens_arena)
+        && ARENA_InitializeDefault(&ast->lhs_arena)
+        && ARENA_InitializeDefault(&ast->rhs_arena)
+        && ARENA_InitializeDefault(&ast->extra_arena);
+    if (!reserved) ARENA_ExitOutOfMemory();
+
+    ast->kinds = null;
+    ast->tokens = null;
+    ast->lhs = null;
+    ast->rhs = null;
+    ast->len = 0;
+    ast->cap = 0;
+
+    ast->extra = null;
+    ast->extra_len = 0;
+    ast->extra_cap = 0;
+
+    ast->root = AST_NONE;
+
+    // Handle 0 is AST_NONE.
+    AST_AddNode(ast, ASTK_UNKNOWN, 0, AST_NONE, AST_NONE);
+}
+
+void AST_Release(ast_t* ast)
+{
+    ARENA_Release(&ast->kinds_arena);
+    ARENA_Release(&ast->tokens_arena);
+    ARENA_Release(&ast->lhs_arena);
+    ARENA_Release(&ast->rhs_arena);
+    ARENA_Release(&ast->extra_arena);
+    ast->len = 0;
+    ast->cap = 0;
+    ast->extra_len = 0;
+    ast->extra_cap = 0;
+}
+
+// Drops every node but keeps the columns and their capacity, for reusing the
+// storage of a tree that is no longer needed.
+void AST_Clear(ast_t* ast)
+{
+    ast->len = 0;
+    ast->extra_len = 0;
+    ast->root = AST_NONE;
+    AST_AddNode(ast, ASTK_UNKNOWN, 0, AST_NONE, AST_NONE);
+}
+
+void AST_Grow(ast_t* ast)
+{
+    // Every column is the only allocation in its arena, so none of them move.
+    uint32 cap = ast->cap;
+    uint32 new_cap = cap > 0 ? cap * 2 : AST_INITIAL_CAPACITY;
+
+    // Nodes are written whole when they are added, so nothing is zeroed.
+    ast->kinds = ARENA_ResizeAlignedNoZero(&ast->kinds_arena, ast->kinds, cap * sizeof(uint8), new_cap * sizeof(uint8), sizeof(uint8));
+    ast->tokens = ARENA_ResizeAlignedNoZero(&ast->tokens_arena, ast->tokens, cap * sizeof(uint32), new_cap * sizeof(uint32), sizeof(uint32));
+    ast->lhs = ARENA_ResizeAlignedNoZero(&ast->lhs_arena, ast->lhs, cap * sizeof(uint32), new_cap * sizeof(uint32), sizeof(uint32));
+    ast->rhs = ARENA_ResizeAlignedNoZero(&ast->rhs_arena, ast->rhs, cap * sizeof(uint32), new_cap * sizeof(uint32), sizeof(uint32));
+    if (!ast->kinds || !ast->tokens || !ast->lhs || !ast->rhs) ARENA_ExitOutOfMemory();
+    ast->cap = new_cap;
+}
+
+ast_handle_t AST_AddNode(ast_t* ast, ast_kind_t kind, uint32 token, uint32 lhs, uint32 rhs)
+{
+    if (ast->len == ast->cap) AST_Grow(ast);
+
+    ast_handle_t node = ast->len++;
+    ast->kinds[node] = cast(uint8) kind;
+    ast->tokens[node] = token;
+    ast->lhs[node] = lhs;
+    ast->rhs[node] = rhs;
+    return node;
+}
+
+// Returns the index of the first of the `len` words in `extra`. Without
+// `data`, they are only reserved for the caller to fill in.
+uint32 AST_AddExtra(ast_t* ast, const uint32* data, uint32 len)
+{
+    if (ast->extra_cap - ast->extra_len < len) {
+        uint32 new_cap = ast->extra_cap > 0 ? ast->extra_cap : AST_INITIAL_CAPACITY;
+        while (new_cap - ast->extra_len < len) new_cap *= 2;
+
+        // Reserved words are the caller's to fill in, so nothing is zeroed.
+        ast->extra = ARENA_ResizeAlignedNoZero(&ast->extra_arena, ast->extra, ast->extra_cap * sizeof(uint32),
+                                               new_cap * sizeof(uint32), sizeof(uint32));
+        if (!ast->extra) ARENA_ExitOutOfMemory();
+        ast->extra_cap = new_cap;
+    }
+
+    uint32 index = ast->extra_len;
+    if (data != null && len > 0) memcpy(ast->extra + index, data, len * sizeof(uint32));
+    ast->extra_len += len;
+    return index;
+}
+
+// Handles of a tree that is copied to `offset` nodes further along.
+static force_inline uint32 AST_Relocate(uint32 handle, uint32 offset)
+{
+    return handle == AST_NONE ? AST_NONE : handle + offset;
+}
+
+// Adds `count` nodes for the caller to fill in, and returns the first.
+ast_handle_t AST_ReserveNodes(ast_t* ast, uint32 count)
+{
+    while (ast->cap - ast->len < count) AST_Grow(ast);
+
+    ast_handle_t first = ast->len;
+    ast->len += count;
+    return first;
+}
+
+// Copies nodes [1, nodes_len) and extra [0, extra_len) of `other` into room
+// reserved at `first` and `extra_first`, as if they had been added to `ast`
+// there in the first place. Separate ranges can be filled in concurrently.
+void AST_CopyFrom(ast_t* ast, ast_handle_t first, uint32 extra_first, ast_t* other, uint32 nodes_len, uint32 extra_len)
+{
+    assert(nodes_len >= 1 && nodes_len <= other->len && extra_len <= other->extra_len);
+
+    uint32 count = nodes_len - 1;
+    uint32 node_offset = first - 1;
+    uint32 extra_offset = extra_first;
+
+    memcpy(ast->kinds + first, other->kinds + 1, count * sizeof(uint8));
+    memcpy(ast->tokens + first, other->tokens + 1, count * sizeof(uint32));
+    if (extra_len > 0) memcpy(ast->extra + extra_first, other->extra, extra_len * sizeof(uint32));
+
+    // Every list and record in `extra` belongs to exactly one node, so each
+    // is fixed up once, by its owner.
+    uint32* extra = ast->extra;
+    for (uint32 i = 0; i < count; ++i) {
+        uint32 lhs = other->lhs[i + 1];
+        uint32 rhs = other->rhs[i + 1];
+        ast_handle_t node = first + i;
+
+        switch (ast->kinds[node]) {
+            case ASTK_PROGRAM:
+            case ASTK_BLOCK: {
+                lhs += extra_offset;
+                for (uint32 s = 0; s < rhs; ++s) {
+                    extra[lhs + s] = AST_Relocate(extra[lhs + s], node_offset);
+                }
+                break;
+            }
+            case ASTK_FUNCTION_DECLARATION: {
+                lhs = AST_Relocate(lhs, node_offset);
+                rhs += extra_offset;
+
+                ast_function_t* function = cast(ast_function_t*) (extra + rhs);
+                function->return_type = AST_Relocate(function->return_type, node_offset);
+                function->body = AST_Relocate(function->body, node_offset);
+
+                ast_handle_t* parameters = extra + rhs + sizeof(ast_function_t) / sizeof(uint32);
+                for (uint32 p = 0; p < function->parameters_len; ++p) {
+                    parameters[p] = AST_Relocate(parameters[p], node_offset);
+                }
+                break;
+            }
+            default:
+                // Everywhere else both words are handles or AST_NONE.
+                lhs = AST_Relocate(lhs, node_offset);
+                rhs = AST_Relocate(rhs, node_offset);
+                break;
+        }
 
-ast_program_t AST_CreateProgramNode()
+        ast->lhs[node] = lhs;
+        ast->rhs[node] = rhs;
+    }
+}
+
+// Copies nodes [first, last] of `other` to the end of `ast`, each with the
+// list or record it owns, and returns where `last` went. Token indices move
+// by `token_offset`. Handles may only point inside the range, but for the
+// bodies of functions: one parsed on demand was added later, elsewhere, and
+// the copy is left without it, to be parsed again when asked for.
+ast_handle_t AST_CopyRange(ast_t* ast, ast_t* other, ast_handle_t first, ast_handle_t last, uint32 token_offset)
+{
+    assert(first != AST_NONE && first <= last && last < other->len);
+
+    uint32 count = last - first + 1;
+    ast_handle_t to = AST_ReserveNodes(ast, count);
+    uint32 node_offset = to - first;
+
+    memcpy(ast->kinds + to, other->kinds + first, count * sizeof(uint8));
+    for (uint32 i = 0; i < count; ++i) {
+        ast_handle_t node = to + i;
+        uint32 lhs = other->lhs[first + i];
+        uint32 rhs = other->rhs[first + i];
+        ast->tokens[node] = other->tokens[first + i] + token_offset;
+
+        switch (ast->kinds[node]) {
+            case ASTK_PROGRAM:
+            case ASTK_BLOCK: {
+                uint32 list = AST_AddExtra(ast, other->extra + lhs, rhs);
+                for (uint32 s = 0; s < rhs; ++s) {
+                    ast->extra[list + s] = AST_Relocate(ast->extra[list + s], node_offset);
+                }
+                lhs = list;
+                break;
+            }
+            case ASTK_FUNCTION_DECLARATION: {
+                ast_function_t* old = cast(ast_function_t*) (other->extra + rhs);
+                uint32 words = sizeof(ast_function_t) / sizeof(uint32);
+                lhs = AST_Relocate(lhs, node_offset);
+                rhs = AST_AddExtra(ast, other->extra + rhs, words + old->parameters_len);
+
+                ast_function_t* function = cast(ast_function_t*) (ast->extra + rhs);
+                function->return_type = AST_Relocate(function->return_type, node_offset);
+                function->body = function->body >= first && function->body <= last ? function->body + node_offset : AST_NONE;
+                if (function->body_open != 0) {
+                    function->body_open += token_offset;
+                    function->body_close += token_offset;
+                }
+
+                ast_handle_t* parameters = ast->extra + rhs + words;
+                for (uint32 p = 0; p < function->parameters_len; ++p) {
+                    parameters[p] = AST_Relocate(parameters[p], node_offset);
+                }
+                break;
+            }
+            default:
+                lhs = AST_Relocate(lhs, node_offset);
+                rhs = AST_Relocate(rhs, node_offset);
+                break;
+        }
+
+        ast->lhs[node] = lhs;
+        ast->rhs[node] = rhs;
+    }
+
+    return last + node_offset;
+}
+
+// Only valid until the next AST_AddExtra().
+ast_function_t* AST_GetFunction(ast_t* ast, ast_handle_t node)
 {
-    ast_program_t program;
-    program.statements_len = 0;
-    return program;
+    assert(ast->kinds[node] == ASTK_FUNCTION_DECLARATION);
+    return cast(ast_function_t*) (ast->extra + ast->rhs[node]);
+}
+
+ast_handle_t* AST_GetParameters(ast_t* ast, ast_handle_t node)
+{
+    return ast->extra + ast->rhs[node] + sizeof(ast_function_t) / sizeof(uint32);
 }
 
 // @FIXME: Maybe follow the same approach as we do for tokens,
 // where this is a plain array. Check what's faster.
-const char* AST_GetNodeID(ast_node_t* node)
+const char* AST_GetNodeID(ast_kind_t kind)
 {
-    switch (node->kind) {
+    switch (kind) {
         case ASTK_EXPR:
         case ASTK_BINARY:
+        case ASTK_UNARY:
+        case ASTK_GROUP:
             return "Expression";
         case ASTK_STMT:
             return "Statement";
+        case ASTK_ERROR:
+            return "Error";
+        case ASTK_BLOCK:
+            return "Block";
         case ASTK_IDENTIFIER:
             return "Identifier";
         case ASTK_KEYWORD:
@@ -56,64 +298,135 @@ const char* AST_GetNodeID(ast_node_t* node)
     }
 }
 
-void AST_DumpNode(ast_node_t* node, uint8 depth, bool has_child)
+// Prints an expression on one line, in order. Expressions can be thousands
+// of operators deep, so this keeps a stack of its own instead of recursing.
+void AST_DumpExpression(ast_t* ast, token_buffer_t* tokens, ast_handle_t root)
+{
+    // Every node is visited once before its operands and, if it has
+    // something to print after its first operand, once more after that.
+    struct visit
+    {
+        ast_handle_t node;
+        bool after_first;
+    };
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t stack;
+    VECTOR_Initialize(&stack, scratch.arena, sizeof(struct visit));
+    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { root, false };
+
+    while (stack.len > 0) {
+        struct visit visit = *cast(struct visit*) VECTOR_Pop(&stack);
+        ast_handle_t node = visit.node;
+        string_t literal = TOKEN_Literal(TOKEN_FromBuffer(tokens, ast->tokens[node]), tokens->code);
+
+        switch (ast->kinds[node]) {
+            case ASTK_BINARY: {
+                if (visit.after_first) {
+                    TRACE_Printf(" %.*s ", cast(int) literal.len, literal.data);
+                    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { ast->rhs[node], false };
+                } else {
+                    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { node, true };
+                    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { ast->lhs[node], false };
+                }
+                break;
+            }
+            case ASTK_UNARY: {
+                TRACE_Printf("%.*s", cast(int) literal.len, literal.data);
+                *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { ast->lhs[node], false };
+                break;
+            }
+            case ASTK_GROUP: {
+                if (visit.after_first) {
+                    TRACE_Printf(")");
+                } else {
+                    TRACE_Printf("(");
+                    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { node, true };
+                    *cast(struct visit*) VECTOR_Push(&stack) = (struct visit) { ast->lhs[node], false };
+                }
+                break;
+            }
+            case ASTK_ERROR: {
+                // Inside an expression, an error stands for a missing operand.
+                TRACE_Printf("<error>");
+                break;
+            }
+            default:
+                TRACE_Printf("%.*s", cast(int) literal.len, literal.data);
+                break;
+        }
+    }
+
+    ARENA_ReleaseScratch(scratch);
+}
+
+void AST_DumpNode(ast_t* ast, token_buffer_t* tokens, ast_handle_t node, uint8 depth, bool has_child)
 {
+    ast_kind_t kind = ast->kinds[node];
     if (depth > 0) {
-        printf("\n");
+        TRACE_Printf("\n");
         uint spaces = depth * 4 - depth;
         for (uint i = 0; i < spaces; ++i) {
-            printf(" ");
+            TRACE_Printf(" ");
         }
 
         if (has_child) {
-            printf("└──│[%s] ", AST_GetNodeID(node));
+            TRACE_Printf("└──│[%s] ", AST_GetNodeID(kind));
         } else {
-            printf("└───[%s] ", AST_GetNodeID(node));
+            TRACE_Printf("└───[%s] ", AST_GetNodeID(kind));
         }
     }
 
-    switch (node->kind) {
+    switch (kind) {
         case ASTK_EXPR:
+        case ASTK_BINARY:
+        case ASTK_UNARY:
+        case ASTK_GROUP:
+            AST_DumpExpression(ast, tokens, node);
+            break;
         case ASTK_IDENTIFIER:
         case ASTK_KEYWORD:
         case ASTK_FUNCTION_PARAMETER:
         case ASTK_FUNCTION_RETURN_TYPE: {
-            string_t literal = node->token.literal;
-            printf("%s", literal.data);
-            break;
-        }
-        case ASTK_BINARY: {
-            ast_binary_op_t* binop = cast(ast_binary_op_t*) node;
-            const char* op = cast(const char*) binop->token.literal.data;
-            AST_DumpNode(binop->left, 0, false);
-            printf(" %s ", op);
-            AST_DumpNode(binop->right, 0, false);
+            string_t literal = TOKEN_Literal(TOKEN_FromBuffer(tokens, ast->tokens[node]), tokens->code);
+            TRACE_Printf("%.*s", cast(int) literal.len, literal.data);
             break;
         }
         case ASTK_VARIABLE_ASSIGNMENT: {
-            ast_declaration_t* decl = cast(ast_declaration_t*) node;
-            ast_variable_declaration_t variable_decl = cast(ast_variable_declaration_t) decl->variable;
-            AST_DumpNode(variable_decl.name_with_type->name, depth+1, false);
+            AST_DumpNode(ast, tokens, ast->lhs[node], depth+1, false);
             // @TODO: Dump the type of the variable.
-            // AST_DumpNode(assignment->name_with_type->type, depth+1, false);
-            AST_DumpNode(variable_decl.expression, depth+1, false);
+            AST_DumpNode(ast, tokens, ast->rhs[node], depth+1, false);
             break;
         }
         case ASTK_FUNCTION_DECLARATION: {
-            ast_declaration_t* decl = cast(ast_declaration_t*) node;
-            ast_function_declaration_t function_decl = cast(ast_function_declaration_t) decl->function;
-            AST_DumpNode(function_decl.name, depth+1, true);
+            AST_DumpNode(ast, tokens, ast->lhs[node], depth+1, true);
 
-            ast_name_with_type_t* next_parameter = function_decl.signature->parameters[0];
-            uint i = 0;
-            while (next_parameter != null) {
+            ast_function_t function = *AST_GetFunction(ast, node);
+            ast_handle_t* parameters = AST_GetParameters(ast, node);
+            for (uint32 i = 0; i < function.parameters_len; ++i) {
                 // @TODO: dump for types
-                AST_DumpNode(next_parameter->name, depth+2, false);
-                i += 1;
-                next_parameter = function_decl.signature->parameters[i];
+                AST_DumpNode(ast, tokens, parameters[i], depth+2, false);
             }
 
-            AST_DumpNode(function_decl.signature->return_type, depth+1, false);
+            AST_DumpNode(ast, tokens, function.return_type, depth+1, function.body != AST_NONE);
+            if (function.body != AST_NONE) {
+                AST_DumpNode(ast, tokens, function.body, depth+1, false);
+            }
+            break;
+        }
+        case ASTK_ERROR: {
+            string_t literal = TOKEN_Literal(TOKEN_FromBuffer(tokens, ast->tokens[node]), tokens->code);
+            TRACE_Printf("%.*s", cast(int) literal.len, literal.data);
+            if (ast->lhs[node] != AST_NONE) {
+                AST_DumpNode(ast, tokens, ast->lhs[node], depth+1, false);
+            }
+            break;
+        }
+        case ASTK_BLOCK: {
+            ast_handle_t* statements = ast->extra + ast->lhs[node];
+            for (uint32 i = 0; i < ast->rhs[node]; ++i) {
+                AST_DumpNode(ast, tokens, statements[i], depth+1, i + 1 < ast->rhs[node]);
+            }
             break;
         }
         default:
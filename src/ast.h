@@ -26,8 +26,13 @@ enum ast_kind
 {
     ASTK_UNKNOWN,
 
+    ASTK_PROGRAM,
+    ASTK_BLOCK,
     ASTK_BINARY,
+    ASTK_UNARY,
+    ASTK_GROUP,
     ASTK_STMT,
+    ASTK_ERROR,
     ASTK_EXPR,
     ASTK_IDENTIFIER,
     ASTK_KEYWORD,
@@ -38,81 +43,85 @@ enum ast_kind
 };
 typedef enum ast_kind ast_kind_t;
 
-// @TODO: Check how can we make `token` a pointer?
-struct ast_node {
-    ast_kind_t kind;
-    token_t token;
-};
-typedef struct ast_node ast_node_t;
-typedef struct ast_node ast_statement_t;
-typedef struct ast_node ast_identifier_t;
-typedef struct ast_node ast_expression_t;
-
-#define MAX_STATEMENTS 1024
-struct ast_program
-{
-    // @TODO: use arena
-    uint16 statements_len;
-    ast_statement_t* statements[MAX_STATEMENTS];
-};
-typedef struct ast_program ast_program_t;
-
-struct ast_binary_op
+// Nodes are addressed by handles, indices into the columns of an ast_t.
+// Handle 0 is never a node, so it stands for "no node".
+typedef uint32 ast_handle_t;
+#define AST_NONE 0
+
+#define AST_INITIAL_CAPACITY 1024
+
+// Every node is a kind, the index of its token and two more words, `lhs` and
+// `rhs`, whose meaning depends on the kind:
+//
+//   ASTK_PROGRAM               Statements are extra[lhs .. lhs+rhs).
+//   ASTK_BLOCK                 Same as ASTK_PROGRAM. The token is `{`.
+//   ASTK_BINARY                Operands. The token is the operator.
+//   ASTK_UNARY                 The operand in lhs. The token is the operator.
+//   ASTK_GROUP                 The parenthesized expression in lhs. The
+//                              token is `(`.
+//   ASTK_ERROR                 What was parsed before the error in lhs, if
+//                              anything. The token is the unexpected one.
+//   ASTK_VARIABLE_ASSIGNMENT   The name and the expression. The token is `:=`.
+//   ASTK_FUNCTION_DECLARATION  The name, and where its ast_function_t starts
+//                              in `extra`. The token is `fun`.
+//   ASTK_IDENTIFIER,
+//   ASTK_FUNCTION_PARAMETER    Its type (an identifier) in lhs, if any.
+//
+// Every other kind is a leaf that only has a token. Children always come
+// before their parent, so a whole tree is walked front to back. The one
+// exception are function bodies parsed on demand, see PARSER_GetFunctionBody().
+struct ast
 {
-    ast_kind_t kind;
-    token_t token;
-
-    ast_expression_t* left;
-    ast_expression_t* right;
+    uint8* kinds;
+    uint32* tokens; // Indices into the token buffer.
+    uint32* lhs;
+    uint32* rhs;
+    uint32 len;
+    uint32 cap;
+
+    // Lists of children, and whatever else does not fit in two words.
+    uint32* extra;
+    uint32 extra_len;
+    uint32 extra_cap;
+
+    ast_handle_t root; // The ASTK_PROGRAM, once parsing is done.
+
+    // One per array, so that every one of them grows in place.
+    arena_t kinds_arena;
+    arena_t tokens_arena;
+    arena_t lhs_arena;
+    arena_t rhs_arena;
+    arena_t extra_arena;
 };
-typedef struct ast_binary_op ast_binary_op_t;
+typedef struct ast ast_t;
 
-struct ast_name_with_type
+// Laid out in `extra` for every function declaration, with the handles of
+// its `parameters_len` parameters right after it.
+struct ast_function
 {
-    ast_kind_t kind;
-    ast_identifier_t* name;
-    ast_identifier_t* type; // @TODO: Change this to a proper type?
-};
-typedef struct ast_name_with_type ast_name_with_type_t;
-
-struct ast_variable_declaration
-{
-    ast_name_with_type_t* name_with_type;
-    ast_expression_t* expression;
-    // @TODO: Modifiers (constants etc.)
-};
-typedef struct ast_variable_declaration ast_variable_declaration_t;
-
-#define MAX_PARAMETERS 127
-struct ast_type_signature
-{
-    ast_name_with_type_t* parameters[MAX_PARAMETERS];
-    ast_identifier_t* return_type;
-};
-typedef struct ast_type_signature ast_type_signature_t;
-
-struct ast_function_declaration
-{
-    ast_identifier_t* name;
-    ast_type_signature_t* signature;
-    ast_node_t* body;
-};
-typedef struct ast_function_declaration ast_function_declaration_t;
-
-struct ast_declaration
-{
-    ast_kind_t kind;
-    token_t token;
-
-    union {
-        ast_function_declaration_t function;
-        ast_variable_declaration_t variable;
-    };
+    ast_handle_t return_type;
+    ast_handle_t body; // An ASTK_BLOCK, or AST_NONE until it is parsed.
+    uint32 body_open; // Token indices of the body's braces, 0 without a body.
+    uint32 body_close;
+    uint32 parameters_len;
+    uint32 depth; // How many functions it is nested in.
 };
-typedef struct ast_declaration ast_declaration_t;
+typedef struct ast_function ast_function_t;
+
+void AST_Initialize(ast_t* ast);
+void AST_Release(ast_t* ast);
+void AST_Clear(ast_t* ast);
+ast_handle_t AST_AddNode(ast_t* ast, ast_kind_t kind, uint32 token, uint32 lhs, uint32 rhs);
+uint32 AST_AddExtra(ast_t* ast, const uint32* data, uint32 len);
+ast_handle_t AST_ReserveNodes(ast_t* ast, uint32 count);
+void AST_CopyFrom(ast_t* ast, ast_handle_t first, uint32 extra_first, ast_t* other, uint32 nodes_len, uint32 extra_len);
+ast_handle_t AST_CopyRange(ast_t* ast, ast_t* other, ast_handle_t first, ast_handle_t last, uint32 token_offset);
+ast_function_t* AST_GetFunction(ast_t* ast, ast_handle_t node);
+ast_handle_t* AST_GetParameters(ast_t* ast, ast_handle_t node);
 
 /* Helpers */
-const char* AST_GetNodeID(ast_node_t* node);
-void AST_DumpNode(ast_node_t* node, uint8 depth, bool has_child);
+const char* AST_GetNodeID(ast_kind_t kind);
+void AST_DumpExpression(ast_t* ast, token_buffer_t* tokens, ast_handle_t root);
+void AST_DumpNode(ast_t* ast, token_buffer_t* tokens, ast_handle_t node, uint8 depth, bool has_child);
 
 #endif // AST_H
@@ -0,0 +1,689 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Starts from a document of `code` parsed as a whole. `code` has to outlive
+// the document, since its identifiers are views into it, just like with
+// LEXER_Tokenize(). The lexer and the parser only ever see one run at a time.
+void DOCUMENT_Initialize(document_t* document, string_t code, bool lazy_bodies, uint thread_count)
+{
+    assert(code.len <= LEXER_MAX_SOURCE_SIZE);
+
+    document->lexer = LEXER_Create(code);
+    document->tokens = LEXER_TokenizeParallel(&document->lexer, thread_count);
+    document->lexer.copy_symbols = true;
+    document->parser = PARSER_Create(&document->lexer, &document->tokens);
+    document->parser.lazy_bodies = lazy_bodies;
+    ARENA_Initialize(&document->view.arena, null, 0);
+
+    bool reserved = ARENA_InitializeDefault(&document->runs_arena)
+        && ARENA_InitializeDefault(&document->text_arena)
+        && ARENA_InitializeDefault(&document->errors_arena);
+    if (!reserved) ARENA_ExitOutOfMemory();
+    ARENA_Initialize(&document->statements_arena, null, 0);
+
+    document->runs = null;
+    document->runs_len = 0;
+    document->runs_cap = 0;
+    DOCUMENT_AddRun(document, code, 0);
+
+    document->errors = null;
+    document->errors_len = 0;
+    document->errors_cap = 0;
+
+#define X(type, column, field) document->column = null;
+    DOCUMENT_COLUMNS(X)
+#undef X
+    document->statements_len = 0;
+    document->statements_cap = 0;
+    DOCUMENT_GrowStatements(document, AST_INITIAL_CAPACITY);
+
+    // An empty document, which the whole file is then inserted into.
+    document->nodes[0] = AST_NONE;
+    document->first_nodes[0] = AST_NONE;
+    document->starts[0] = 0;
+    document->offsets[0] = 0;
+    document->lines[0] = 1;
+    document->columns[0] = 1;
+    document->first_errors[0] = 0;
+    document->errors_lens[0] = 0;
+
+    document->len = 0;
+    document->live_nodes = 0;
+    document->compactions = 0;
+    document->has_spare_ast = false;
+
+    document_reparse_t reparse;
+    reparse.first = 0;
+    reparse.begin = 0;
+    reparse.edit_end = UINT32_MAX;
+    reparse.shift = cast(uint32) code.len;
+    reparse.resume = 0;
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    VECTOR_Initialize(&reparse.parsed, scratch.arena, sizeof(document_statement_t));
+    DOCUMENT_ViewRun(document, 0);
+    bool parsed = DOCUMENT_ParseRun(document, &reparse, true);
+    assert(parsed);
+    DOCUMENT_Commit(document, &reparse);
+    ARENA_ReleaseScratch(scratch);
+}
+
+void DOCUMENT_Release(document_t* document)
+{
+    PARSER_Destroy(&document->parser);
+    TOKEN_ReleaseBuffer(&document->tokens);
+    ARENA_Release(&document->runs_arena);
+    ARENA_Release(&document->text_arena);
+    ARENA_Release(&document->statements_arena);
+    ARENA_Release(&document->errors_arena);
+    if (document->has_spare_ast) AST_Release(&document->spare_ast);
+}
+
+// Replaces the text between edit.start and edit.end, and parses again from
+// the statement before the one the edit starts in, until a statement starts
+// where an old one after the edit did. That one and everything after it are
+// kept as they are: none of their nodes or tokens moves, only their entries
+// in the statement table do.
+void DOCUMENT_ApplyEdit(document_t* document, text_edit_t edit)
+{
+    assert(edit.start <= edit.end && edit.end <= document->len);
+    uint32 n = document->statements_len;
+
+    // The statement before the edit has seen the first token of the one the
+    // edit starts in, which may be different now.
+    uint32 changed = DOCUMENT_FindStatement(document, edit.start);
+    if (changed > 0 && document->offsets[changed] == edit.start) changed -= 1;
+
+    document_reparse_t reparse;
+    reparse.first = changed > 0 ? changed - 1 : 0;
+    reparse.begin = reparse.first > 0 ? document->offsets[reparse.first] : 0;
+    reparse.edit_end = edit.start + cast(uint32) edit.text.len;
+    reparse.shift = cast(uint32) edit.text.len - (edit.end - edit.start);
+
+    uint32 low = reparse.first;
+    uint32 high = n;
+    while (low < high) {
+        uint32 middle = low + (high - low) / 2;
+        if (document->offsets[middle] < edit.end) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    reparse.resume = low;
+
+    // Most edits stay inside a statement or two, so only a few statements
+    // after the edit are lexed with it at first. Each time that is not enough
+    // to resynchronize, twice as many are.
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    for (uint64 ahead = 2;; ahead *= 2) {
+        uint32 window = ahead < n - reparse.resume ? reparse.resume + cast(uint32) ahead : n;
+        VECTOR_Initialize(&reparse.parsed, scratch.arena, sizeof(document_statement_t));
+        if (DOCUMENT_Reparse(document, edit, &reparse, window)) break;
+    }
+    DOCUMENT_Commit(document, &reparse);
+    ARENA_ReleaseScratch(scratch);
+
+    // Everything edits left behind is only reclaimed once it outgrows what
+    // is in use, so that each compaction is paid for by as many edits.
+    uint32 dead_nodes = document->parser.ast.len - 1 - document->live_nodes;
+    if (dead_nodes > document->live_nodes || document->text_arena.curr_offset > 2 * (cast(size) document->len + IO_SOURCE_PADDING)) {
+        DOCUMENT_Compact(document);
+    }
+}
+
+// Lexes the text of the statements [reparse->first, window) with the edit
+// applied as a run of its own, and parses it. Takes all of it back when that
+// was not far enough to resynchronize.
+bool DOCUMENT_Reparse(document_t* document, text_edit_t edit, document_reparse_t* reparse, uint32 window)
+{
+    uint32 end = document->offsets[window];
+    uint32 before = edit.start - reparse->begin;
+    size len = cast(size) before + edit.text.len + (end - edit.end);
+
+    arena_temp_t text_mark = ARENA_TempBegin(&document->text_arena);
+    uint8* text = ARENA_AllocNoZero(&document->text_arena, len + IO_SOURCE_PADDING);
+    if (!text) ARENA_ExitOutOfMemory();
+    DOCUMENT_CopyText(document, reparse->begin, edit.start, text);
+    memcpy(text + before, edit.text.data, edit.text.len);
+    DOCUMENT_CopyText(document, edit.end, end, text + before + edit.text.len);
+    memset(text + len, 0, IO_SOURCE_PADDING);
+
+    uint32 tokens_len = document->tokens.len;
+    uint32 numbers_len = document->lexer.numbers_len;
+    uint32 nodes_len = document->parser.ast.len;
+    uint32 extra_len = document->parser.ast.extra_len;
+    uint32 errors_len = document->errors_len;
+
+    lexer_t* lexer = &document->lexer;
+    lexer->code = STRING_SIZED(text, len);
+    lexer->cur_pos = 0;
+    lexer->next_pos = 0;
+    LEXER_TokenizeInto(lexer, &document->tokens);
+    DOCUMENT_AddRun(document, lexer->code, tokens_len);
+    DOCUMENT_ViewRun(document, document->runs_len - 1);
+
+    if (DOCUMENT_ParseRun(document, reparse, window == document->statements_len)) return true;
+
+    document->tokens.len = tokens_len;
+    document->lexer.numbers_len = numbers_len;
+    document->parser.ast.len = nodes_len;
+    document->parser.ast.extra_len = extra_len;
+    document->errors_len = errors_len;
+    document->runs_len -= 1;
+    ARENA_TempEnd(text_mark);
+    return false;
+}
+
+// Parses the last run from its start, one top-level statement after the
+// other, until one starts where an old statement after the edit started:
+// both see the same text from there on, so they are the same statement.
+// Fails at the end of a run that stops short of the end of the document,
+// since the statement before it might have gone on past it.
+bool DOCUMENT_ParseRun(document_t* document, document_reparse_t* reparse, bool reaches_end)
+{
+    parser_t* parser = &document->parser;
+    token_buffer_t* view = &document->view;
+    document_run_t* run = &document->runs[document->runs_len - 1];
+    uint32 n = document->statements_len;
+
+    document_locator_t locator;
+    locator.text = run->text;
+    locator.offset = 0;
+    locator.line = 1;
+    locator.line_start = 0;
+    if (reparse->first > 0) {
+        locator.line = document->lines[reparse->first];
+        locator.line_start = 1 - cast(int64) document->columns[reparse->first];
+    }
+
+    // The parser uses the first scratch arena itself, and gives back
+    // whatever it took from it after every statement.
+    arena_temp_t scratch = ARENA_GetScratch(&reparse->parsed.arena, 1);
+    deferred_errors_t deferred;
+    ERROR_BeginDeferred(&deferred, scratch.arena);
+    scoped_error_t* reported = &deferred.first;
+
+    parser->cursor = 0;
+    parser->panicking = false;
+    parser->depth = 0;
+
+    bool parsed = true;
+    uint32 next = reparse->resume;
+    while (true) {
+        uint32 cursor = parser->cursor;
+        source_location_t location = DOCUMENT_Locate(&locator, view->offsets[cursor]);
+
+        document_statement_t statement;
+        statement.node = AST_NONE;
+        statement.first_node = AST_NONE;
+        statement.start = run->first_token + cursor;
+        statement.offset = reparse->begin + view->offsets[cursor];
+        statement.line = location.line;
+        statement.column = location.column;
+        statement.first_error = document->errors_len;
+        statement.errors_len = 0;
+
+        if (view->kinds[cursor] == TK_EOF) {
+            reparse->stop = statement;
+            reparse->reached_end = true;
+            parsed = reaches_end;
+            break;
+        }
+
+        if (statement.offset >= reparse->edit_end && (reparse->parsed.len > 0 || reparse->first > 0)) {
+            uint32 old = statement.offset - reparse->shift;
+            while (next < n && document->offsets[next] < old) next += 1;
+            if (next < n && document->offsets[next] == old) {
+                reparse->stop = statement;
+                reparse->kept = next;
+                reparse->reached_end = false;
+                break;
+            }
+        }
+
+        ast_handle_t first_node = parser->ast.len;
+        statement.node = PARSER_ParseStatement(parser);
+        if (statement.node != AST_NONE) statement.first_node = first_node;
+
+        for (; reported->next_error != null; reported = reported->next_error) {
+            DOCUMENT_AddError(document, reported->next_error);
+            statement.errors_len += 1;
+        }
+
+        *cast(document_statement_t*) VECTOR_Push(&reparse->parsed) = statement;
+        PARSER_ConsumeToken(parser);
+    }
+
+    ERROR_EndDeferred();
+    ARENA_ReleaseScratch(scratch);
+    return parsed;
+}
+
+// Puts the statements a reparse parsed in place of the ones it replaced,
+// and moves the ones after them to where they are now.
+void DOCUMENT_Commit(document_t* document, document_reparse_t* reparse)
+{
+    uint32 n = document->statements_len;
+    uint32 first = reparse->first;
+    uint32 removed = (reparse->reached_end ? n + 1 : reparse->kept) - first;
+    uint32 inserted = reparse->parsed.len + (reparse->reached_end ? 1 : 0);
+    uint32 entries = n + 1 - removed + inserted;
+    uint32 kept = first + inserted;
+
+    if (entries > document->statements_cap) {
+        uint32 cap = document->statements_cap + document->statements_cap / 2;
+        DOCUMENT_GrowStatements(document, entries > cap ? entries : cap);
+    }
+
+    for (uint32 s = first; s < first + removed; ++s) {
+        if (document->nodes[s] != AST_NONE) document->live_nodes -= document->nodes[s] - document->first_nodes[s] + 1;
+    }
+
+    if (!reparse->reached_end) {
+#define X(type, column, field) \
+        memmove(document->column + kept, document->column + reparse->kept, (n + 1 - reparse->kept) * sizeof(type));
+        DOCUMENT_COLUMNS(X)
+#undef X
+    }
+
+    for (uint32 i = 0; i < inserted; ++i) {
+        document_statement_t* statement = i < reparse->parsed.len ? VECTOR_Get(&reparse->parsed, i) : &reparse->stop;
+#define X(type, column, field) document->column[first + i] = statement->field;
+        DOCUMENT_COLUMNS(X)
+#undef X
+        if (statement->node != AST_NONE) document->live_nodes += statement->node - statement->first_node + 1;
+    }
+
+    // Only the statements on the line the edit ended on move sideways.
+    if (!reparse->reached_end) {
+        uint32 line = document->lines[kept];
+        uint32 line_delta = reparse->stop.line - line;
+        uint32 column_delta = reparse->stop.column - document->columns[kept];
+        for (uint32 s = kept; s < entries && document->lines[s] == line; ++s) {
+            document->columns[s] += column_delta;
+        }
+        for (uint32 s = kept; s < entries; ++s) {
+            document->offsets[s] += reparse->shift;
+            document->lines[s] += line_delta;
+        }
+    }
+
+    document->statements_len = entries - 1;
+    document->len += reparse->shift;
+}
+
+// Copies everything in use to new buffers, in order, as one run: the text,
+// the tokens, the numbers, the symbols, the nodes and the errors.
+void DOCUMENT_Compact(document_t* document)
+{
+    uint32 n = document->statements_len;
+    ast_t* ast = &document->parser.ast;
+
+    arena_t text_arena;
+    if (!ARENA_InitializeDefault(&text_arena)) ARENA_ExitOutOfMemory();
+    uint8* text = ARENA_Alloc(&text_arena, cast(size) document->len + IO_SOURCE_PADDING);
+    if (!text) ARENA_ExitOutOfMemory();
+    DOCUMENT_CopyText(document, 0, document->len, text);
+
+    // Same worst case as LEXER_Tokenize(), pages never written to cost nothing.
+    token_buffer_t tokens;
+    tokens.code = STRING_SIZED(text, document->len);
+    tokens.len = 0;
+    tokens.cap = document->len + 1;
+    if (!ARENA_InitializeVirtual(&tokens.arena, TOKEN_BUFFER_RESERVE(cast(size) tokens.cap))) ARENA_ExitOutOfMemory();
+    tokens.kinds = ARENA_AllocAlignedNoZero(&tokens.arena, tokens.cap * sizeof(uint8), sizeof(uint8));
+    tokens.offsets = ARENA_AllocAlignedNoZero(&tokens.arena, tokens.cap * sizeof(uint32), sizeof(uint32));
+    tokens.lengths = ARENA_AllocAlignedNoZero(&tokens.arena, tokens.cap * sizeof(uint32), sizeof(uint32));
+    tokens.values = ARENA_AllocAlignedNoZero(&tokens.arena, tokens.cap * sizeof(uint32), sizeof(uint32));
+    if (!tokens.kinds || !tokens.offsets || !tokens.lengths || !tokens.values) ARENA_ExitOutOfMemory();
+
+    lexer_t* lexer = &document->lexer;
+    arena_t literal_arena = lexer->literal_arena;
+    number_t* numbers = lexer->numbers;
+    uint32 numbers_len = lexer->numbers_len;
+    if (!ARENA_InitializeDefault(&lexer->literal_arena)) ARENA_ExitOutOfMemory();
+    lexer->numbers = null;
+    lexer->numbers_len = 0;
+    lexer->numbers_cap = 0;
+    // Every live number is somewhere in the old table.
+    LEXER_ReserveNumbers(lexer, numbers_len + 1);
+
+    // Only the symbols live tokens still use are interned again, so that the
+    // spellings an identifier went through while it was typed do not stay
+    // around for the whole session. Old symbol -> new one, SYMBOL_NONE until
+    // it is first met.
+    intern_table_t symbols;
+    INTERN_Initialize(&symbols);
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    symbol_t* symbol_map = ARENA_Alloc(scratch.arena, lexer->symbols.strings_len * sizeof(symbol_t));
+    if (!symbol_map) ARENA_ExitOutOfMemory();
+
+    ast_t compacted;
+    if (document->has_spare_ast) {
+        compacted = document->spare_ast;
+        AST_Clear(&compacted);
+    } else {
+        AST_Initialize(&compacted);
+    }
+
+    arena_t errors_arena;
+    if (!ARENA_InitializeDefault(&errors_arena)) ARENA_ExitOutOfMemory();
+    scoped_error_t* errors = ARENA_AllocNoZero(&errors_arena, (document->errors_cap > 0 ? document->errors_cap : 1) * sizeof(scoped_error_t));
+    uint32 errors_len = 0;
+    if (!errors) ARENA_ExitOutOfMemory();
+
+    for (uint32 s = 0; s <= n; ++s) {
+        uint32 start = document->starts[s];
+        uint32 count = DOCUMENT_CountTokens(document, s);
+        uint32 rebase = document->offsets[s] - document->tokens.offsets[start];
+        uint32 first_token = document->runs[DOCUMENT_FindRun(document, start)].first_token;
+
+        uint32 at = tokens.len;
+        memcpy(tokens.kinds + at, document->tokens.kinds + start, count * sizeof(uint8));
+        memcpy(tokens.lengths + at, document->tokens.lengths + start, count * sizeof(uint32));
+        for (uint32 i = 0; i < count; ++i) {
+            uint32 value = document->tokens.values[start + i];
+            if (tokens.kinds[at + i] == TK_NUMBER_LITERAL) {
+                value = lexer->numbers_len++;
+                lexer->numbers[value] = numbers[document->tokens.values[start + i]];
+            } else if (tokens.kinds[at + i] == TK_IDENTIFIER) {
+                if (symbol_map[value] == SYMBOL_NONE) {
+                    symbol_map[value] = INTERN_Intern(&symbols, INTERN_GetString(&lexer->symbols, value));
+                }
+                value = symbol_map[value];
+            }
+            tokens.offsets[at + i] = document->tokens.offsets[start + i] + rebase;
+            tokens.values[at + i] = value;
+        }
+        tokens.len += count;
+
+        // Node tokens count from the start of their run.
+        if (document->nodes[s] != AST_NONE) {
+            ast_handle_t first = document->first_nodes[s];
+            ast_handle_t last = AST_CopyRange(&compacted, ast, first, document->nodes[s], at - (start - first_token));
+            document->first_nodes[s] = last - (document->nodes[s] - first);
+            document->nodes[s] = last;
+        }
+
+        for (uint32 e = 0; e < document->errors_lens[s]; ++e) {
+            scoped_error_t* error = &errors[errors_len + e];
+            *error = document->errors[document->first_errors[s] + e];
+            error->token.offset += rebase;
+        }
+        document->first_errors[s] = errors_len;
+        errors_len += document->errors_lens[s];
+        document->starts[s] = at;
+    }
+    assert(tokens.kinds[tokens.len - 1] == TK_EOF);
+
+    ARENA_ReleaseScratch(scratch);
+    INTERN_Release(&lexer->symbols);
+    lexer->symbols = symbols;
+
+    ARENA_Release(&literal_arena);
+    TOKEN_ReleaseBuffer(&document->tokens);
+    document->tokens = tokens;
+    document->spare_ast = *ast;
+    document->has_spare_ast = true;
+    *ast = compacted;
+
+    ARENA_Release(&document->errors_arena);
+    document->errors_arena = errors_arena;
+    document->errors = errors;
+    document->errors_len = errors_len;
+    document->errors_cap = document->errors_cap > 0 ? document->errors_cap : 1;
+
+    ARENA_Release(&document->text_arena);
+    document->text_arena = text_arena;
+    document->runs_len = 0;
+    DOCUMENT_AddRun(document, tokens.code, 0);
+
+    document->live_nodes = ast->len - 1;
+    document->compactions += 1;
+}
+
+// The last statement that starts at or before `offset`, or the first one.
+// The end of the document counts as a statement.
+uint32 DOCUMENT_FindStatement(document_t* document, uint32 offset)
+{
+    uint32 low = 0;
+    uint32 high = document->statements_len + 1;
+    while (low < high) {
+        uint32 middle = low + (high - low) / 2;
+        if (document->offsets[middle] <= offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low > 0 ? low - 1 : 0;
+}
+
+// The run the token at `token` in the document's buffer was lexed in.
+uint32 DOCUMENT_FindRun(document_t* document, uint32 token)
+{
+    uint32 low = 0;
+    uint32 high = document->runs_len;
+    while (low < high) {
+        uint32 middle = low + (high - low) / 2;
+        if (document->runs[middle].first_token <= token) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    assert(low > 0);
+    return low - 1;
+}
+
+// How many tokens a statement has, up to where the next one starts. The end
+// of the document only has its TK_EOF.
+uint32 DOCUMENT_CountTokens(document_t* document, uint32 statement)
+{
+    if (statement == document->statements_len) return 1;
+
+    uint32 start = document->starts[statement];
+    uint32 end = document->tokens.offsets[start] + (document->offsets[statement + 1] - document->offsets[statement]);
+    uint32 token = start;
+    while (document->tokens.offsets[token] < end) token += 1;
+    return token - start;
+}
+
+// Points the parser at the tokens of `run`, which the nodes parsed from them
+// index from its first one.
+void DOCUMENT_ViewRun(document_t* document, uint32 run)
+{
+    document_run_t* viewed = &document->runs[run];
+    token_buffer_t* view = &document->view;
+    view->code = viewed->text;
+    view->kinds = document->tokens.kinds + viewed->first_token;
+    view->offsets = document->tokens.offsets + viewed->first_token;
+    view->lengths = document->tokens.lengths + viewed->first_token;
+    view->values = document->tokens.values + viewed->first_token;
+    view->len = viewed->tokens_len;
+    view->cap = viewed->tokens_len;
+    document->parser.tokens = view;
+}
+
+// Copies the text between `from` and `to` to `destination`, from the runs of
+// the statements it belongs to.
+void DOCUMENT_CopyText(document_t* document, uint32 from, uint32 to, uint8* destination)
+{
+    uint32 s = DOCUMENT_FindStatement(document, from);
+    while (from < to) {
+        // Only a document without statements has text in its end, before it.
+        uint32 end = to;
+        if (s < document->statements_len && document->offsets[s + 1] < to) end = document->offsets[s + 1];
+        document_run_t* run = &document->runs[DOCUMENT_FindRun(document, document->starts[s])];
+        uint32 at = document->tokens.offsets[document->starts[s]] - document->offsets[s] + from;
+
+        memcpy(destination, run->text.data + at, end - from);
+        destination += end - from;
+        from = end;
+        s += 1;
+    }
+}
+
+// Moves the statement table to columns with room for `cap` entries.
+void DOCUMENT_GrowStatements(document_t* document, uint32 cap)
+{
+    arena_t arena;
+    if (!ARENA_InitializeDefault(&arena)) ARENA_ExitOutOfMemory();
+
+    uint32 entries = document->statements_cap > 0 ? document->statements_len + 1 : 0;
+#define X(type, column, field) \
+    type* column = ARENA_AllocAlignedNoZero(&arena, cap * sizeof(type), sizeof(type)); \
+    if (!column) ARENA_ExitOutOfMemory(); \
+    if (entries > 0) memcpy(column, document->column, entries * sizeof(type)); \
+    document->column = column;
+    DOCUMENT_COLUMNS(X)
+#undef X
+
+    ARENA_Release(&document->statements_arena);
+    document->statements_arena = arena;
+    document->statements_cap = cap;
+}
+
+void DOCUMENT_AddRun(document_t* document, string_t text, uint32 first_token)
+{
+    if (document->runs_len == document->runs_cap) {
+        uint32 cap = document->runs_cap > 0 ? document->runs_cap * 2 : 16;
+        if (document->runs == null) {
+            document->runs = ARENA_AllocNoZero(&document->runs_arena, cap * sizeof(document_run_t));
+        } else {
+            document->runs = ARENA_Resize(&document->runs_arena, document->runs,
+                                          document->runs_cap * sizeof(document_run_t), cap * sizeof(document_run_t));
+        }
+        if (!document->runs) ARENA_ExitOutOfMemory();
+        document->runs_cap = cap;
+    }
+
+    document_run_t* run = &document->runs[document->runs_len++];
+    run->text = text;
+    run->first_token = first_token;
+    run->tokens_len = document->tokens.len - first_token;
+}
+
+void DOCUMENT_AddError(document_t* document, scoped_error_t* error)
+{
+    if (document->errors_len == document->errors_cap) {
+        uint32 cap = document->errors_cap > 0 ? document->errors_cap * 2 : 16;
+        if (document->errors == null) {
+            document->errors = ARENA_AllocNoZero(&document->errors_arena, cap * sizeof(scoped_error_t));
+        } else {
+            document->errors = ARENA_Resize(&document->errors_arena, document->errors,
+                                            document->errors_cap * sizeof(scoped_error_t), cap * sizeof(scoped_error_t));
+        }
+        if (!document->errors) ARENA_ExitOutOfMemory();
+        document->errors_cap = cap;
+    }
+
+    scoped_error_t* copy = &document->errors[document->errors_len++];
+    *copy = *error;
+    copy->next_error = null;
+}
+
+// Locations are only known where statements start, see document_t. A
+// locator goes forward from there through the text of the statement's run.
+void DOCUMENT_StartLocator(document_t* document, document_locator_t* locator, uint32 statement)
+{
+    uint32 start = document->starts[statement];
+    locator->text = document->runs[DOCUMENT_FindRun(document, start)].text;
+    locator->offset = document->tokens.offsets[start];
+    locator->line = document->lines[statement];
+    locator->line_start = cast(int64) locator->offset - (document->columns[statement] - 1);
+}
+
+source_location_t DOCUMENT_Locate(document_locator_t* locator, uint32 offset)
+{
+    assert(offset >= locator->offset && offset <= locator->text.len);
+
+    for (size i = STRING_FindByte(locator->text, locator->offset, '\n'); i < offset;
+         i = STRING_FindByte(locator->text, i + 1, '\n')) {
+        locator->line += 1;
+        locator->line_start = cast(int64) i + 1;
+    }
+    locator->offset = offset;
+
+    source_location_t location;
+    location.line = locator->line;
+    location.column = cast(uint32) (offset - locator->line_start + 1);
+    return location;
+}
+
+// Prints the errors of every statement, in order.
+void DOCUMENT_ReportErrors(document_t* document)
+{
+    for (uint32 s = 0; s < document->statements_len; ++s) {
+        if (document->errors_lens[s] == 0) continue;
+
+        document_locator_t locator;
+        DOCUMENT_StartLocator(document, &locator, s);
+        for (uint32 e = 0; e < document->errors_lens[s]; ++e) {
+            scoped_error_t* error = &document->errors[document->first_errors[s] + e];
+            if (error->token.offset < locator.offset) DOCUMENT_StartLocator(document, &locator, s);
+            ERROR_Print(error, DOCUMENT_Locate(&locator, error->token.offset), locator.text);
+        }
+    }
+}
+
+void DOCUMENT_DumpTokens(document_t* document)
+{
+    // Without the TK_EOF at the end, like TOKEN_DumpBuffer().
+    for (uint32 s = 0; s < document->statements_len; ++s) {
+        uint32 start = document->starts[s];
+        string_t code = document->runs[DOCUMENT_FindRun(document, start)].text;
+        uint32 count = DOCUMENT_CountTokens(document, s);
+        for (uint32 i = 0; i < count; ++i) {
+            TOKEN_Dump(TOKEN_FromBuffer(&document->tokens, start + i), code);
+        }
+    }
+}
+
+// Prints the tree like PARSER_DumpAST(). Bodies a lazy parser skipped are
+// parsed on the way, and their errors printed right away.
+void DOCUMENT_DumpAST(document_t* document)
+{
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    arena_temp_t error_scratch = ARENA_GetScratch(&scratch.arena, 1);
+
+    TRACE_Printf("│[Program]\n");
+    for (uint32 s = 0; s < document->statements_len; ++s) {
+        if (document->nodes[s] == AST_NONE) continue;
+
+        deferred_errors_t deferred;
+        DOCUMENT_ViewRun(document, DOCUMENT_FindRun(document, document->starts[s]));
+        ERROR_BeginDeferred(&deferred, error_scratch.arena);
+        PARSER_DumpStatement(&document->parser, document->nodes[s]);
+        ERROR_EndDeferred();
+
+        document_locator_t locator;
+        DOCUMENT_StartLocator(document, &locator, s);
+        for (scoped_error_t* error = deferred.first.next_error; error != null; error = error->next_error) {
+            if (error->token.offset < locator.offset) DOCUMENT_StartLocator(document, &locator, s);
+            ERROR_Print(error, DOCUMENT_Locate(&locator, error->token.offset), locator.text);
+        }
+    }
+
+    ARENA_ReleaseScratch(error_scratch);
+    ARENA_ReleaseScratch(scratch);
+}
@@ -0,0 +1,169 @@
+// Copyright 2024 Benjamín García Roqués <benjamingarciaroques@gmail.com>
+
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+// Replaces the bytes [start, end) of a document with `text`.
+struct text_edit
+{
+    uint32 start;
+    uint32 end;
+    string_t text;
+};
+typedef struct text_edit text_edit_t;
+
+// A piece of a document's text that was lexed on its own. The offsets of its
+// tokens are relative to `text`, and so are the token indices in the nodes
+// parsed from them, relative to `first_token`. Its tokens end with a TK_EOF,
+// which is only where the document ends if the run got that far.
+struct document_run
+{
+    string_t text; // Followed by IO_SOURCE_PADDING zero bytes.
+    uint32 first_token; // Index of its first token in the document's buffer.
+    uint32 tokens_len;
+};
+typedef struct document_run document_run_t;
+
+// One entry of the statement table, see document_t.
+struct document_statement
+{
+    ast_handle_t node;
+    ast_handle_t first_node; // Its nodes are [first_node, node].
+    uint32 start;  // Index of its first token in the document's buffer.
+    uint32 offset; // Where that token is in the document,
+    uint32 line;   // and its line and column there.
+    uint32 column;
+    uint32 first_error; // Its errors are errors[first_error .. first_error+errors_len).
+    uint32 errors_len;
+};
+typedef struct document_statement document_statement_t;
+
+// Every column of the statement table, as X(type, column, field). The field
+// is the one in document_statement_t.
+#define DOCUMENT_COLUMNS(X) \
+    X(ast_handle_t, nodes, node) \
+    X(ast_handle_t, first_nodes, first_node) \
+    X(uint32, starts, start) \
+    X(uint32, offsets, offset) \
+    X(uint32, lines, line) \
+    X(uint32, columns, column) \
+    X(uint32, first_errors, first_error) \
+    X(uint32, errors_lens, errors_len)
+
+// A file kept parsed while it is edited. An edit never moves what it does not
+// replace: the text around it is lexed and parsed as a run of its own, and
+// the statement table says which run every top-level statement is in. After
+// an edit, only the entries after it move, see DOCUMENT_ApplyEdit().
+struct document
+{
+    lexer_t lexer;
+    parser_t parser;
+    token_buffer_t tokens; // The tokens of every run, one run after the other.
+    token_buffer_t view;   // The tokens of one run, see DOCUMENT_ViewRun().
+
+    document_run_t* runs;
+    uint32 runs_len;
+    uint32 runs_cap;
+    arena_t runs_arena;
+
+    // Text of the runs edits made. The first run is the file itself.
+    arena_t text_arena;
+
+    // The top-level statements in order, and one more entry for the TK_EOF
+    // that ends the document. Its text before the first statement is in the
+    // first entry's run, and each statement's text runs up to where the next
+    // entry starts.
+#define X(type, column, field) type* column;
+    DOCUMENT_COLUMNS(X)
+#undef X
+    uint32 statements_len; // Without the end.
+    uint32 statements_cap;
+    arena_t statements_arena;
+
+    // The statements' errors, with offsets relative to their runs.
+    scoped_error_t* errors;
+    uint32 errors_len;
+    uint32 errors_cap;
+    arena_t errors_arena;
+
+    uint32 len; // Bytes of text.
+    uint32 live_nodes; // Nodes the statements use. Edits leave the rest behind.
+    uint32 compactions;
+
+    // The tree from before the last compaction. The next one copies the live
+    // nodes into its columns, so that compacting over and over moves nodes
+    // between the same two sets of pages.
+    ast_t spare_ast;
+    bool has_spare_ast;
+};
+typedef struct document document_t;
+
+// State of one attempt at parsing an edit, see DOCUMENT_ApplyEdit().
+struct document_reparse
+{
+    uint32 first;    // The first statement parsed again.
+    uint32 begin;    // Where the run starts, in the edited document.
+    uint32 edit_end; // Where the edit's text ends in it.
+    uint32 shift;    // How far the text after the edit moved, modulo 2^32.
+    uint32 resume;   // The first old statement that may start where it did.
+
+    segmented_vector_t parsed; // The new statements, as document_statement_t.
+    document_statement_t stop; // Where parsing stopped: the first statement
+    uint32 kept;               // kept, or the end of the document.
+    bool reached_end;
+};
+typedef struct document_reparse document_reparse_t;
+
+// Where DOCUMENT_Locate() last was in the text of a run.
+struct document_locator
+{
+    string_t text;
+    uint32 offset;
+    uint32 line;
+    int64 line_start; // Before the run starts for its first line.
+};
+typedef struct document_locator document_locator_t;
+
+void DOCUMENT_Initialize(document_t* document, string_t code, bool lazy_bodies, uint thread_count);
+void DOCUMENT_Release(document_t* document);
+void DOCUMENT_ApplyEdit(document_t* document, text_edit_t edit);
+void DOCUMENT_Compact(document_t* document);
+
+uint32 DOCUMENT_FindStatement(document_t* document, uint32 offset);
+uint32 DOCUMENT_FindRun(document_t* document, uint32 token);
+uint32 DOCUMENT_CountTokens(document_t* document, uint32 statement);
+void DOCUMENT_ViewRun(document_t* document, uint32 run);
+void DOCUMENT_CopyText(document_t* document, uint32 from, uint32 to, uint8* destination);
+void DOCUMENT_GrowStatements(document_t* document, uint32 cap);
+void DOCUMENT_AddRun(document_t* document, string_t text, uint32 first_token);
+void DOCUMENT_AddError(document_t* document, scoped_error_t* error);
+bool DOCUMENT_ParseRun(document_t* document, document_reparse_t* reparse, bool reaches_end);
+void DOCUMENT_Commit(document_t* document, document_reparse_t* reparse);
+bool DOCUMENT_Reparse(document_t* document, text_edit_t edit, document_reparse_t* reparse, uint32 window);
+
+void DOCUMENT_StartLocator(document_t* document, document_locator_t* locator, uint32 statement);
+source_location_t DOCUMENT_Locate(document_locator_t* locator, uint32 offset);
+void DOCUMENT_ReportErrors(document_t* document);
+void DOCUMENT_DumpTokens(document_t* document);
+void DOCUMENT_DumpAST(document_t* document);
+
+#endif // DOCUMENT_H
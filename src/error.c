@@ -19,52 +19,101 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+// While set, errors reported on this thread are collected here, see
+// ERROR_BeginDeferred().
+static thread_local deferred_errors_t* error_deferred = null;
+
+// Errors printed so far. Only the main thread prints, see ERROR_ReportDeferred().
+static uint32 error_count = 0;
+
 scoped_error_t ERROR_MakeScoped()
 {
     scoped_error_t scoped_error;
     scoped_error.error_kind = ERRORK_NO_ERROR;
-    scoped_error.token = null;
-    scoped_error.previous_error = null;
+    scoped_error.token.kind = TK_UNKNOWN;
+    scoped_error.expected = TK_UNKNOWN;
     scoped_error.next_error = null;
     return scoped_error;
 }
 
-void ERROR_PushScope(scoped_error_t* root, arena_t* scratch, error_kind_t kind, token_t* token)
+void ERROR_Report(scoped_error_t* error, lexer_t* lexer)
 {
-    scoped_error_t* tail = root;
-    while (tail != null && tail->next_error != null) {
-        tail = tail->next_error;
+    if (error_deferred != null) {
+        if (error->error_kind == ERRORK_NO_ERROR) return;
+
+        scoped_error_t* copy = cast(scoped_error_t*) ARENA_AllocNoZero(error_deferred->arena, sizeof(scoped_error_t));
+        if (!copy) ARENA_ExitOutOfMemory();
+        copy->error_kind = error->error_kind;
+        copy->token = error->token;
+        copy->expected = error->expected;
+        copy->next_error = null;
+        error_deferred->last->next_error = copy;
+        error_deferred->last = copy;
+        return;
     }
 
-    scoped_error_t* new_error = cast(scoped_error_t*) ARENA_Alloc(scratch, sizeof(scoped_error_t));
-    new_error->error_kind = kind;
-    new_error->token = token;
-    new_error->previous_error = tail;
-    new_error->next_error = null;
-    tail->next_error = new_error;
+    if (error->error_kind == ERRORK_NO_ERROR) return;
+    ERROR_Print(error, LEXER_GetLocation(lexer, error->token.offset), lexer->code);
 }
 
-void ERROR_ReportScope(scoped_error_t* error)
+// Prints an error whose location is already known. `code` is the source the
+// offset of its token is relative to.
+void ERROR_Print(scoped_error_t* error, source_location_t location, string_t code)
 {
-    // @TODO: We want to output the error back to the user in a condensed form,
-    // i.e., with all errors applied to a single message. If possible, we don't want
-    // the user to think much about what the error is, but rather make it clearly visible
-    // where the errors are.
-    scoped_error_t* current_error = error;
-    while (current_error != null) {
-        ERROR_Report(current_error);
-        current_error = current_error->next_error;
+    if (error->error_kind != ERRORK_NO_ERROR) {
+        error_count += 1;
     }
-}
 
-void ERROR_Report(scoped_error_t* error)
-{
     switch (error->error_kind) {
         case ERRORK_UNEXPECTED_TOKEN: {
-            fprintf(stderr, "unexpected token: found %s.\n", token_names[error->token->kind]);
+            if (error->expected != TK_UNKNOWN) {
+                fprintf(stderr, "%u:%u: unexpected token: expected %s, found %s.\n", location.line, location.column,
+                        token_names[error->expected], token_names[error->token.kind]);
+            } else {
+                fprintf(stderr, "%u:%u: unexpected token: found %s.\n", location.line, location.column, token_names[error->token.kind]);
+            }
+            break;
+        }
+        case ERRORK_NUMBER_OUT_OF_RANGE: {
+            string_t literal = TOKEN_Literal(error->token, code);
+            fprintf(stderr, "%u:%u: number literal out of range: %.*s does not fit in 64 bits.\n",
+                    location.line, location.column, cast(int) literal.len, literal.data);
+            break;
+        }
+        case ERRORK_NESTED_TOO_DEEP: {
+            fprintf(stderr, "%u:%u: function nested too deeply: at most %u levels are allowed.\n",
+                    location.line, location.column, PARSER_MAX_NESTING);
             break;
         }
         default:
             break;
     }
 }
+
+uint32 ERROR_GetCount(void)
+{
+    return error_count;
+}
+
+// Until ERROR_EndDeferred(), errors reported on the calling thread are kept
+// in `arena` in the order they happened, rather than printed. Locations are
+// only looked up once they are printed, by ERROR_ReportDeferred().
+void ERROR_BeginDeferred(deferred_errors_t* deferred, arena_t* arena)
+{
+    deferred->first = ERROR_MakeScoped();
+    deferred->last = &deferred->first;
+    deferred->arena = arena;
+    error_deferred = deferred;
+}
+
+void ERROR_EndDeferred(void)
+{
+    error_deferred = null;
+}
+
+void ERROR_ReportDeferred(deferred_errors_t* deferred, lexer_t* lexer)
+{
+    for (scoped_error_t* error = deferred->first.next_error; error != null; error = error->next_error) {
+        ERROR_Report(error, lexer);
+    }
+}
@@ -26,22 +26,37 @@ enum error_kind
 {
     ERRORK_NO_ERROR,
     ERRORK_UNEXPECTED_TOKEN,
+    ERRORK_NUMBER_OUT_OF_RANGE,
+    ERRORK_NESTED_TOO_DEEP,
 };
 typedef enum error_kind error_kind_t;
 
 struct scoped_error
 {
     error_kind_t error_kind;
-    token_t* token;
+    token_t token;
+    token_kind_t expected; // What should have been there instead, if known.
 
-    struct scoped_error* previous_error;
-    struct scoped_error* next_error;
+    struct scoped_error* next_error; // Only used by deferred errors.
 };
 typedef struct scoped_error scoped_error_t;
 
+// Errors held back instead of printed, for threads that cannot print yet.
+struct deferred_errors
+{
+    scoped_error_t first; // Placeholder root, the errors start after it.
+    scoped_error_t* last;
+    arena_t* arena;
+};
+typedef struct deferred_errors deferred_errors_t;
+
 scoped_error_t ERROR_MakeScoped();
-void ERROR_PushScope(scoped_error_t* error, arena_t* scratch, error_kind_t kind, token_t* token);
-void ERROR_ReportScope(scoped_error_t* error);
-void ERROR_Report(scoped_error_t* error);
+void ERROR_Report(scoped_error_t* error, lexer_t* lexer);
+void ERROR_Print(scoped_error_t* error, source_location_t location, string_t code);
+uint32 ERROR_GetCount(void);
+
+void ERROR_BeginDeferred(deferred_errors_t* deferred, arena_t* arena);
+void ERROR_EndDeferred(void);
+void ERROR_ReportDeferred(deferred_errors_t* deferred, lexer_t* lexer);
 
 #endif // ERROR_H
@@ -19,33 +19,166 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
-#define IS_ALPHA(c) (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z'))
-#define IS_ALPHANUMERIC(c) (IS_DIGIT(c) || (IS_ALPHA(c)))
-
-#define LEXER_LITERAL_LIMIT 131072
-static byte* literal_buffer[LEXER_LITERAL_LIMIT];
+enum lexer_char_flag
+{
+    LCF_WHITESPACE  = 1 << 0, // [ \t\r\n]
+    LCF_OPERATOR    = 1 << 1, // Starts a one- or two-character token.
+    LCF_DIGIT       = 1 << 2, // [0-9]
+    LCF_IDENT_START = 1 << 3, // [A-Za-z]
+};
+
+// Only decides what kind of token starts at a character, the runs of
+// whitespace, numbers and identifiers are skipped with LEXER_SkipClass().
+static const uint8 lexer_char_flags[256] = {
+    [' '] = LCF_WHITESPACE, ['\t'] = LCF_WHITESPACE, ['\r'] = LCF_WHITESPACE, ['\n'] = LCF_WHITESPACE,
+
+    ['0' ... '9'] = LCF_DIGIT,
+    ['A' ... 'Z'] = LCF_IDENT_START,
+    ['a' ... 'z'] = LCF_IDENT_START,
+
+    ['+'] = LCF_OPERATOR, ['-'] = LCF_OPERATOR, ['*'] = LCF_OPERATOR, ['/'] = LCF_OPERATOR,
+    ['^'] = LCF_OPERATOR, [','] = LCF_OPERATOR, [':'] = LCF_OPERATOR, [';'] = LCF_OPERATOR,
+    ['?'] = LCF_OPERATOR, ['`'] = LCF_OPERATOR, ['='] = LCF_OPERATOR, ['>'] = LCF_OPERATOR,
+    ['<'] = LCF_OPERATOR, ['{'] = LCF_OPERATOR, ['}'] = LCF_OPERATOR, ['['] = LCF_OPERATOR,
+    [']'] = LCF_OPERATOR, ['('] = LCF_OPERATOR, [')'] = LCF_OPERATOR, ['|'] = LCF_OPERATOR,
+    ['&'] = LCF_OPERATOR, ['!'] = LCF_OPERATOR, ['.'] = LCF_OPERATOR,
+};
+
+// The token an operator character makes on its own.
+static const uint8 lexer_single_tokens[256] = {
+    ['+'] = TK_PLUS,
+    ['-'] = TK_MINUS,
+    ['*'] = TK_ASTERISK,
+    ['/'] = TK_SLASH,
+    ['^'] = TK_EXPONENT,
+    ['.'] = TK_DOT,
+    [','] = TK_COMMA,
+    [':'] = TK_COLON,
+    [';'] = TK_SEMICOLON,
+    ['?'] = TK_QUESTION_MARK,
+    ['`'] = TK_BACKTICK,
+    ['!'] = TK_EXCLAMATION_MARK,
+    ['='] = TK_EQUALS,
+    ['>'] = TK_GREATER_THAN,
+    ['<'] = TK_LESS_THAN,
+    ['{'] = TK_CURLY_BRACE_OPEN,
+    ['}'] = TK_CURLY_BRACE_CLOSE,
+    ['['] = TK_SQUARE_BRACKET_OPEN,
+    [']'] = TK_SQUARE_BRACKET_CLOSE,
+    ['('] = TK_PARENTHESIS_OPEN,
+    [')'] = TK_PARENTHESIS_CLOSE,
+    ['|'] = TK_ILLEGAL, // @TODO: bitwise OR
+    ['&'] = TK_ILLEGAL, // @TODO: bitwise AND
+};
+
+// Characters that may start a two-character token move into one of these
+// states, and the next character picks the token from lexer_double_tokens.
+enum lexer_operator_state
+{
+    LOS_NONE,
+    LOS_MINUS,
+    LOS_COLON,
+    LOS_PIPE,
+    LOS_AMPERSAND,
+    LOS_EXCLAMATION_MARK,
+    LOS_EQUALS,
+    LOS_GREATER_THAN,
+    LOS_LESS_THAN,
+    LOS_SQUARE_BRACKET_OPEN,
+
+    LOS_COUNT,
+};
+
+static const uint8 lexer_operator_states[256] = {
+    ['-'] = LOS_MINUS,
+    [':'] = LOS_COLON,
+    ['|'] = LOS_PIPE,
+    ['&'] = LOS_AMPERSAND,
+    ['!'] = LOS_EXCLAMATION_MARK,
+    ['='] = LOS_EQUALS,
+    ['>'] = LOS_GREATER_THAN,
+    ['<'] = LOS_LESS_THAN,
+    ['['] = LOS_SQUARE_BRACKET_OPEN,
+};
+
+// TK_UNKNOWN means that the second character is not part of the token.
+static const uint8 lexer_double_tokens[LOS_COUNT][256] = {
+    [LOS_MINUS]['>']               = TK_THIN_ARROW,
+    [LOS_COLON]['=']               = TK_ASSIGNMENT_OPERATOR,
+    [LOS_PIPE]['|']                = TK_LOGICAL_OR,
+    [LOS_AMPERSAND]['&']           = TK_LOGICAL_AND,
+    [LOS_EXCLAMATION_MARK]['=']    = TK_NOT_EQUALS,
+    [LOS_EQUALS]['=']              = TK_DOUBLE_EQUALS,
+    [LOS_EQUALS]['>']              = TK_FAT_ARROW,
+    [LOS_GREATER_THAN]['=']        = TK_GREATER_OR_EQUALS_TO,
+    [LOS_LESS_THAN]['=']           = TK_LESS_OR_EQUALS_TO,
+    [LOS_SQUARE_BRACKET_OPEN][']'] = TK_ARRAY_BRACKETS,
+};
+
+// A perfect hash of the keywords on their length, first and last characters:
+// every keyword gets a slot of its own, so deciding whether an identifier is
+// a keyword takes a single compare, however many keywords there are.
+#define KEYWORD_TABLE_SIZE 32
+#define KEYWORD_HASH(len, first, last) (((len) + (uint8) (first) + (uint8) (last)) & (KEYWORD_TABLE_SIZE-1))
+
+struct keyword
+{
+    string_t name;
+    token_kind_t kind;
+};
+
+static const struct keyword keyword_table[KEYWORD_TABLE_SIZE] = {
+#define X(kind, spelling, first, last, name) \
+    [KEYWORD_HASH(lengthof(spelling), first, last)] = { {cast(uint8*) spelling, lengthof(spelling)}, kind },
+    KEYWORDS(X)
+#undef X
+};
+
+// Fails to compile when two keywords hash to the same slot: the sum of the
+// slot bits only equals their union when no bit was set twice. Tweak
+// KEYWORD_HASH() (or the table size) when adding a keyword trips this.
+#define KEYWORD_SLOT_ADD(kind, spelling, first, last, name) + (1ull << KEYWORD_HASH(lengthof(spelling), first, last))
+#define KEYWORD_SLOT_OR(kind, spelling, first, last, name)  | (1ull << KEYWORD_HASH(lengthof(spelling), first, last))
+typedef char keyword_hash_is_perfect[(0 KEYWORDS(KEYWORD_SLOT_ADD)) == (0 KEYWORDS(KEYWORD_SLOT_OR)) ? 1 : -1];
 
 lexer_t LEXER_Create(string_t code)
 {
     arena_t literal_arena;
-    ARENA_Initialize(&literal_arena, literal_buffer, LEXER_LITERAL_LIMIT);
+    if (!ARENA_InitializeDefault(&literal_arena)) ARENA_ExitOutOfMemory();
 
     lexer_t lexer;
     lexer.code = code;
     lexer.literal_arena = literal_arena;
     lexer.cur_pos = 0;
     lexer.next_pos = 0;
+    lexer.value = 0;
+
+    lexer.numbers = null;
+    lexer.numbers_len = 0;
+    lexer.numbers_cap = 0;
+
+    INTERN_Initialize(&lexer.symbols);
+
+    lexer.line_offsets = null;
+    lexer.lines_len = 0;
+    ARENA_Initialize(&lexer.lines_arena, null, 0);
+
+    lexer.copy_symbols = false;
+
     return lexer;
 }
 
 void LEXER_Destroy(lexer_t* lexer)
 {
-    ARENA_Free(&lexer->literal_arena);
+    ARENA_Release(&lexer->literal_arena);
+    ARENA_Release(&lexer->lines_arena);
+    INTERN_Release(&lexer->symbols);
 }
 
 char LEXER_Peek(lexer_t* lexer)
 {
+    // No bounds check needed: the source is padded with zeroes, and nothing
+    // ever reads past the first one of those.
     assert(lexer->code.data);
     return lexer->code.data[lexer->next_pos];
 }
@@ -57,6 +190,30 @@ void LEXER_ReadChar(lexer_t* lexer)
     lexer->cur_pos = lexer->next_pos++;
 }
 
+// Bytes checked one at a time before a run is handed to the SIMD kernels.
+#define LEXER_SCALAR_RUN 8
+
+// Called for almost every token, hence inlined.
+static force_inline void LEXER_SkipClass(lexer_t* lexer, char_class_t class)
+{
+    // Most runs are short, those are cheaper to finish here than to hand to
+    // a kernel. Nothing reads past the padding: it is in no class.
+    size end = lexer->next_pos;
+    size scalar_end = end + LEXER_SCALAR_RUN;
+    while (end < scalar_end && STRING_IsInClass(lexer->code.data[end], class)) end += 1;
+
+    if (end == scalar_end) {
+        // The kernels can run over the padding in whole blocks, too.
+        string_t padded = STRING_SIZED(lexer->code.data, lexer->code.len + IO_SOURCE_PADDING);
+        end = STRING_FindFirstNotInClass(padded, end, class);
+    }
+    if (end != lexer->next_pos) {
+        lexer->cur_pos = end - 1;
+        lexer->current = lexer->code.data[lexer->cur_pos];
+        lexer->next_pos = end;
+    }
+}
+
 bool LEXER_Match(lexer_t* lexer, char character)
 {
     bool matched = character == LEXER_Peek(lexer);
@@ -64,231 +221,483 @@ bool LEXER_Match(lexer_t* lexer, char character)
     return matched;
 }
 
+token_t LEXER_MakeToken(lexer_t* lexer, token_kind_t kind, uint64 start)
+{
+    // Offsets are 32 bits wide, see LEXER_Tokenize().
+    uint64 length = lexer->next_pos - start;
+    if (length > TOKEN_MAX_LENGTH) {
+        kind = TK_ILLEGAL;
+        length = TOKEN_MAX_LENGTH;
+    }
+
+    token_t token;
+    token.offset = cast(uint32) start;
+    token.length = cast(uint32) length;
+    token.kind = kind;
+    return token;
+}
+
 token_t LEXER_ConsumeToken(lexer_t* lexer)
 {
     assert(lexer->code.data);
 
     token_t token;
-    token.kind = TK_UNKNOWN;
-    token.literal = STRING("");
+    lexer->value = 0;
 
-    if (lexer->next_pos < lexer->code.len
-        && lexer->code.data[lexer->next_pos] != '\0') {
-        LEXER_ReadChar(lexer);
-    } else {
-        token.kind = TK_EOF;
-        return token;
+    uint8 next = LEXER_Peek(lexer);
+    if (lexer_char_flags[next] & LCF_WHITESPACE) {
+        LEXER_SkipClass(lexer, CHAR_CLASS_WHITESPACE);
+        next = LEXER_Peek(lexer);
     }
 
-    while (lexer->current == ' ' || lexer->current == '\n') {
-        LEXER_ReadChar(lexer);
+    // Everything from the end of the code on is EOF. For a whole file that is
+    // the zero padding, for a chunk of one it is the start of the next chunk
+    // (see LEXER_TokenizeParallel()). A NUL before that is an illegal character.
+    if (lexer->next_pos >= lexer->code.len) {
+        return LEXER_MakeToken(lexer, TK_EOF, lexer->next_pos);
     }
 
-    switch (lexer->current) {
-        case '+':
-            token.kind = TK_PLUS;
-            token.literal = STRING("+");
-            break;
-        case '-':
-            if (LEXER_Match(lexer, '>')) {
-                token.kind = TK_THIN_ARROW;
-                token.literal = STRING("->");
-                break;
-            }
+    LEXER_ReadChar(lexer);
 
-            token.kind = TK_MINUS;
-            token.literal = STRING("-");
-            break;
-        case '*':
-            token.kind = TK_ASTERISK;
-            token.literal = STRING("*");
-            break;
-        case '/':
-            token.kind = TK_SLASH;
-            token.literal = STRING("/");
-            break;
-        case '^':
-            token.kind = TK_EXPONENT;
-            token.literal = STRING("^");
-            break;
-        case '.':
-            token.kind = TK_DOT;
-            token.literal = STRING(".");
-            break;
-        case ',':
-            token.kind = TK_COMMA;
-            token.literal = STRING(",");
-            break;
-        case ':':
-            if (LEXER_Match(lexer, '=')) {
-                token.kind = TK_ASSIGNMENT_OPERATOR;
-                token.literal = STRING(":=");
-                break;
-            }
+    uint64 start = lexer->cur_pos;
+    uint8 flags = lexer_char_flags[cast(uint8) lexer->current];
 
-            token.kind = TK_COLON;
-            token.literal = STRING(":");
-            break;
-        case ';':
-            token.kind = TK_SEMICOLON;
-            token.literal = STRING(";");
-            break;
-        case '?':
-            token.kind = TK_QUESTION_MARK;
-            token.literal = STRING("?");
-            break;
-        case '|':
-            if (LEXER_Match(lexer, '|')) {
-                token.kind = TK_LOGICAL_OR;
-                token.literal = STRING("||");
-                break;
+    if (flags & LCF_DIGIT) {
+        token = LEXER_ConsumeNumber(lexer);
+    } else if (flags & LCF_IDENT_START) {
+        token = LEXER_ConsumeString(lexer);
+    } else {
+        // Operators, and everything else as an illegal token.
+        token_kind_t kind = TK_ILLEGAL;
+
+        if (flags & LCF_OPERATOR) {
+            uint8 state = lexer_operator_states[cast(uint8) lexer->current];
+            token_kind_t double_kind = lexer_double_tokens[state][cast(uint8) LEXER_Peek(lexer)];
+            if (double_kind != TK_UNKNOWN) {
+                LEXER_ReadChar(lexer);
+                kind = double_kind;
+            } else {
+                kind = lexer_single_tokens[cast(uint8) lexer->current];
             }
+        }
 
-            // @TODO: bitwise OR
-        case '&':
-            if (LEXER_Match(lexer, '&')) {
-                token.kind = TK_LOGICAL_AND;
-                token.literal = STRING("&&");
-                break;
-            }
+        token = LEXER_MakeToken(lexer, kind, start);
+    }
 
-            // @TODO: bitwise AND
-        case '!':
-            if (LEXER_Match(lexer, '=')) {
-                token.kind = TK_NOT_EQUALS;
-                token.literal = STRING("!=");
-                break;
-            }
-        case '=':
-            if (LEXER_Match(lexer, '=')) {
-                token.kind = TK_DOUBLE_EQUALS;
-                token.literal = STRING("==");
-                break;
-            }
+    return token;
+}
 
-            if (LEXER_Match(lexer, '>')) {
-                token.kind = TK_FAT_ARROW;
-                token.literal = STRING("=>");
-                break;
-            }
-            
-            token.kind = TK_EQUALS;
-            token.literal = STRING("=");
-            break;
-        case '>':
-            if (LEXER_Match(lexer, '=')) {
-                token.kind = TK_GREATER_OR_EQUALS_TO;
-                token.literal = STRING(">=");
-                break;
-            }
+token_t LEXER_ConsumeNumber(lexer_t* lexer)
+{
+    uint64 start = lexer->cur_pos;
 
-            token.kind = TK_GREATER_THAN;
-            token.literal = STRING(">");
-            break;
-        case '<':
-            if (LEXER_Match(lexer, '=')) {
-                token.kind = TK_LESS_OR_EQUALS_TO;
-                token.literal = STRING("<=");
-                break;
-            }
+    LEXER_SkipClass(lexer, CHAR_CLASS_NUMBER);
 
-            token.kind = TK_LESS_THAN;
-            token.literal = STRING("<");
-            break;
-        case '{':
-            token.kind = TK_CURLY_BRACE_OPEN;
-            token.literal = STRING("{");
-            break;
-        case '}':
-            token.kind = TK_CURLY_BRACE_CLOSE;
-            token.literal = STRING("}");
-            break;
-        case '[':
-            if (LEXER_Match(lexer, ']')) {
-                token.kind = TK_ARRAY_BRACKETS;
-                token.literal = STRING("[]");
-                break;
-            }
+    string_t literal = STRING_SIZED(lexer->code.data + start, lexer->next_pos - start);
+    uint num_dots = 0;
+    size dot = literal.len;
+    for (size i = 0; i < literal.len; ++i) {
+        if (literal.data[i] == '.') {
+            num_dots += 1;
+            dot = i;
+        }
+    }
 
-            token.kind = TK_SQUARE_BRACKET_OPEN;
-            token.literal = STRING("[");
-            break;
-        case ']':
-            token.kind = TK_SQUARE_BRACKET_CLOSE;
-            token.literal = STRING("]");
-            break;
-        case '(':
-            token.kind = TK_PARENTHESIS_OPEN;
-            token.literal = STRING("(");
-            break;
-        case ')':
-            token.kind = TK_PARENTHESIS_CLOSE;
-            token.literal = STRING(")");
-            break;
-        default:
-            if (IS_DIGIT(lexer->current)) {
-                token = LEXER_ConsumeNumber(lexer);
-                break;
-            } else if (IS_ALPHA(lexer->current)) {
-                token = LEXER_ConsumeString(lexer);
-                break;
-            }
+    token_t token = LEXER_MakeToken(lexer, num_dots > 1 ? TK_ILLEGAL : TK_NUMBER_LITERAL, start);
+    if (token.kind != TK_NUMBER_LITERAL) return token;
 
-            token.kind = TK_ILLEGAL;
-            break;
+    // Converted here once, so nothing after the lexer ever reparses the text.
+    number_t number;
+    number.integer = 0;
+    if (num_dots == 0) {
+        number.kind = NUMBER_INTEGER;
+        number.overflow = !NUMBER_ParseInteger(literal, &number.integer);
+    } else {
+        number.kind = NUMBER_FLOAT;
+        number.overflow = !NUMBER_ParseDecimal(literal, dot, &number.real);
     }
 
-    TOKEN_Dump(&token);
+    lexer->value = LEXER_AddNumber(lexer, number);
     return token;
 }
 
-token_t LEXER_ConsumeNumber(lexer_t* lexer)
+// Makes room for at least `count` more numbers.
+void LEXER_ReserveNumbers(lexer_t* lexer, uint32 count)
 {
-    string_t number = STRING_FromChar(lexer->current, &lexer->literal_arena);
+    if (lexer->numbers_cap - lexer->numbers_len >= count) return;
 
-    char next_digit = LEXER_Peek(lexer);
-    uint num_dots = 0;
-    while (IS_DIGIT(next_digit) || next_digit == '.') {
-        number = STRING_Append(number, next_digit, &lexer->literal_arena);
-        LEXER_ReadChar(lexer);
-        next_digit = LEXER_Peek(lexer);
-        num_dots += cast(int) (next_digit == '.');
+    uint32 new_cap = lexer->numbers_len + count;
+    if (lexer->numbers == null) {
+        lexer->numbers = ARENA_AllocAlignedNoZero(&lexer->literal_arena, new_cap * sizeof(number_t), sizeof(number_t));
+    } else {
+        lexer->numbers = ARENA_Resize(&lexer->literal_arena, lexer->numbers,
+                                      lexer->numbers_cap * sizeof(number_t), new_cap * sizeof(number_t));
     }
+    if (!lexer->numbers) ARENA_ExitOutOfMemory();
+    lexer->numbers_cap = new_cap;
+}
 
-    token_t token;
-    token.kind = num_dots > 1 ? TK_ILLEGAL : TK_NUMBER_LITERAL;
-    token.literal = number;
-    return token;
+uint32 LEXER_AddNumber(lexer_t* lexer, number_t number)
+{
+    if (lexer->numbers == null) {
+        // Two numbers are always at least a byte apart, so this many always
+        // fit. Just like with LEXER_Tokenize(), pages that are never written
+        // to cost nothing, and the table never has to grow. Unless the arena
+        // could not reserve that much, see ARENA_InitializeDefault().
+        size count = (lexer->code.len - lexer->cur_pos) / 2 + 1;
+        if (count * sizeof(number_t) > lexer->literal_arena.reserve_len) count = 1024;
+        LEXER_ReserveNumbers(lexer, cast(uint32) count);
+    } else if (lexer->numbers_len == lexer->numbers_cap) {
+        // Only sources lexed after the first one, see LEXER_TokenizeInto(),
+        // or under a limited address space add numbers to a full table.
+        LEXER_ReserveNumbers(lexer, lexer->numbers_cap);
+    }
+    assert(lexer->numbers_len < lexer->numbers_cap);
+
+    uint32 index = lexer->numbers_len++;
+    lexer->numbers[index] = number;
+    return index;
 }
 
 token_t LEXER_ConsumeString(lexer_t* lexer)
 {
-    string_t identifier = STRING_FromChar(lexer->current, &lexer->literal_arena);
-    char next_character = LEXER_Peek(lexer);
-    while (IS_ALPHANUMERIC(next_character) || next_character == '_') {
-        identifier = STRING_Append(identifier, next_character, &lexer->literal_arena);
-        LEXER_ReadChar(lexer);
-        next_character = LEXER_Peek(lexer);
+    uint64 start = lexer->cur_pos;
+
+    LEXER_SkipClass(lexer, CHAR_CLASS_IDENTIFIER);
+
+    string_t identifier = STRING_SIZED(lexer->code.data + start, lexer->next_pos - start);
+
+    const struct keyword* keyword = &keyword_table[KEYWORD_HASH(identifier.len, identifier.data[0], identifier.data[identifier.len-1])];
+    if (keyword->name.len == identifier.len && STRING_Equals(&keyword->name, &identifier)) {
+        return LEXER_MakeToken(lexer, keyword->kind, start);
+    }
+
+    // The source outlives the symbol table, so the first occurrence of every
+    // identifier can be its canonical string, no copies needed. Unless the
+    // lexer was told otherwise, see `copy_symbols`.
+    if (!lexer->copy_symbols) {
+        lexer->value = INTERN_InternView(&lexer->symbols, identifier);
+    } else {
+        lexer->value = INTERN_Intern(&lexer->symbols, identifier);
+    }
+    return LEXER_MakeToken(lexer, TK_IDENTIFIER, start);
+}
+
+token_buffer_t LEXER_Tokenize(lexer_t* lexer)
+{
+    assert(lexer->code.len <= LEXER_MAX_SOURCE_SIZE);
+
+    token_buffer_t tokens;
+    tokens.code = lexer->code;
+    tokens.len = 0;
+
+    // Every token but the last one takes up at least one byte, so this many
+    // always fit. Pages that are never written to are never backed by memory,
+    // so sizing for the worst case costs nothing.
+    size cap = lexer->code.len - lexer->next_pos + 1;
+    if (!ARENA_InitializeVirtual(&tokens.arena, TOKEN_BUFFER_RESERVE(cap))) ARENA_ExitOutOfMemory();
+    tokens.kinds = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint8), sizeof(uint8));
+    tokens.offsets = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    tokens.lengths = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    tokens.values = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    if (!tokens.kinds || !tokens.offsets || !tokens.lengths || !tokens.values) ARENA_ExitOutOfMemory();
+    tokens.cap = cast(uint32) cap;
+
+    while (true) {
+        token_t token = LEXER_ConsumeToken(lexer);
+        uint32 i = tokens.len++;
+        assert(i < cap);
+
+        tokens.kinds[i] = cast(uint8) token.kind;
+        tokens.offsets[i] = token.offset;
+        tokens.lengths[i] = token.length;
+        tokens.values[i] = lexer->value;
+        if (token.kind == TK_EOF) break;
     }
 
+    return tokens;
+}
+
+token_t TOKEN_FromBuffer(token_buffer_t* tokens, uint32 index)
+{
+    assert(index < tokens->len);
+
     token_t token;
-    token.kind = TK_IDENTIFIER;
-
-    // @PERFORMANCE: This may be a hashmap. But for now, it works.
-    if (0) {}
-    else if (STRING_Equals(&identifier, &STRING("struct"))) { token.kind = TK_STRUCT; }
-    else if (STRING_Equals(&identifier, &STRING("enum")))   { token.kind = TK_ENUM; }
-    else if (STRING_Equals(&identifier, &STRING("if")))     { token.kind = TK_IF; }
-    else if (STRING_Equals(&identifier, &STRING("else")))   { token.kind = TK_ELSE; }
-    else if (STRING_Equals(&identifier, &STRING("return"))) { token.kind = TK_RETURN; }
-    else if (STRING_Equals(&identifier, &STRING("for")))    { token.kind = TK_FOR; }
-    else if (STRING_Equals(&identifier, &STRING("var")))    { token.kind = TK_VAR; }
-    else if (STRING_Equals(&identifier, &STRING("fun")))    { token.kind = TK_FUN; }
-
-    token.literal = identifier;
+    token.offset = tokens->offsets[index];
+    token.length = tokens->lengths[index];
+    token.kind = tokens->kinds[index];
     return token;
 }
 
-void TOKEN_Dump(token_t* token) {
-    printf("token_t [%s] (literal='%s')\n", token_names[token->kind], token->literal.data);
+void LEXER_TokenizeChunk(void* data)
+{
+    lexer_chunk_t* chunk = cast(lexer_chunk_t*) data;
+    chunk->tokens = LEXER_Tokenize(&chunk->lexer);
+    if (chunk->release_scratch) ARENA_ReleaseThreadScratch();
+}
+
+void LEXER_StitchChunk(void* data)
+{
+    lexer_chunk_t* chunk = cast(lexer_chunk_t*) data;
+    token_buffer_t* output = chunk->output;
+    uint32 first = chunk->output_offset;
+    uint32 len = chunk->tokens.len - 1; // Without its TK_EOF.
+
+    memcpy(output->kinds + first, chunk->tokens.kinds, len * sizeof(uint8));
+    memcpy(output->offsets + first, chunk->tokens.offsets, len * sizeof(uint32));
+    memcpy(output->lengths + first, chunk->tokens.lengths, len * sizeof(uint32));
+    for (uint32 i = 0; i < len; ++i) {
+        uint8 kind = chunk->tokens.kinds[i];
+        uint32 value = chunk->tokens.values[i];
+        if (kind == TK_IDENTIFIER) {
+            value = chunk->symbol_map[value];
+        } else if (kind == TK_NUMBER_LITERAL) {
+            value += chunk->number_offset;
+        }
+        output->values[first + i] = value;
+    }
+}
+
+token_buffer_t LEXER_TokenizeParallel(lexer_t* lexer, uint thread_count)
+{
+    string_t code = lexer->code;
+    uint64 begin = lexer->next_pos;
+    assert(code.len <= LEXER_MAX_SOURCE_SIZE);
+
+    size max_chunks = (code.len - begin) / LEXER_MIN_CHUNK_SIZE;
+    if (thread_count > max_chunks) thread_count = cast(uint) max_chunks;
+    if (thread_count > LEXER_MAX_THREADS) thread_count = LEXER_MAX_THREADS;
+    if (thread_count <= 1) return LEXER_Tokenize(lexer);
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    lexer_chunk_t* chunks = ARENA_Alloc(scratch.arena, thread_count * sizeof(lexer_chunk_t));
+    thread_t threads[LEXER_MAX_THREADS];
+    if (!chunks) ARENA_ExitOutOfMemory();
+
+    // Tokens never contain whitespace, so any whitespace byte is a safe place
+    // to split: move each even split forward to the next one. Every chunk
+    // lexer sees the source up to the end of its chunk, so offsets need no
+    // fixing up, and anything after that is EOF to it.
+    // @TODO: String literals and comments can contain whitespace. Once they
+    // exist, either split on a newline outside of them or lex speculatively
+    // and redo a chunk whose start turned out to be inside one.
+    uint64 start = begin;
+    for (uint c = 0; c < thread_count; ++c) {
+        uint64 end = code.len;
+        if (c + 1 < thread_count) {
+            end = begin + (code.len - begin) * (c + 1) / thread_count;
+            if (end < start) end = start;
+            while (end < code.len && !STRING_IsInClass(code.data[end], CHAR_CLASS_WHITESPACE)) end += 1;
+        }
+
+        chunks[c].lexer = LEXER_Create(STRING_SIZED(code.data, end));
+        chunks[c].lexer.cur_pos = start;
+        chunks[c].lexer.next_pos = start;
+        chunks[c].release_scratch = c > 0;
+        start = end;
+    }
+
+    // The calling thread takes the first chunk itself. A chunk whose thread
+    // did not start runs on the calling thread too, which keeps its scratch.
+    for (uint c = 1; c < thread_count; ++c) {
+        if (!THREAD_Start(&threads[c], LEXER_TokenizeChunk, &chunks[c])) chunks[c].release_scratch = false;
+    }
+    LEXER_TokenizeChunk(&chunks[0]);
+    for (uint c = 1; c < thread_count; ++c) THREAD_Join(&threads[c]);
+
+    // Every chunk interned into a table of its own. Symbols are numbered by
+    // first occurrence, so merging the chunks' tables in order, each in its
+    // own order, gives exactly the symbols the serial lexer would have.
+    uint32 total = 1;
+    uint32 total_numbers = 0;
+    for (uint c = 0; c < thread_count; ++c) total_numbers += chunks[c].lexer.numbers_len;
+    LEXER_ReserveNumbers(lexer, total_numbers);
+
+    for (uint c = 0; c < thread_count; ++c) {
+        intern_table_t* local = &chunks[c].lexer.symbols;
+        chunks[c].symbol_map = ARENA_AllocNoZero(scratch.arena, local->strings_len * sizeof(symbol_t));
+        if (!chunks[c].symbol_map) ARENA_ExitOutOfMemory();
+
+        chunks[c].symbol_map[SYMBOL_NONE] = SYMBOL_NONE;
+        for (symbol_t s = 1; s < local->strings_len; ++s) {
+            chunks[c].symbol_map[s] = INTERN_InternView(&lexer->symbols, local->strings[s]);
+        }
+
+        chunks[c].output_offset = total - 1;
+        total += chunks[c].tokens.len - 1;
+
+        // Numbers are not deduplicated, so they are just appended.
+        lexer_t* chunk_lexer = &chunks[c].lexer;
+        chunks[c].number_offset = lexer->numbers_len;
+        if (chunk_lexer->numbers_len > 0) {
+            memcpy(lexer->numbers + lexer->numbers_len, chunk_lexer->numbers, chunk_lexer->numbers_len * sizeof(number_t));
+            lexer->numbers_len += chunk_lexer->numbers_len;
+        }
+    }
+
+    token_buffer_t tokens;
+    tokens.code = code;
+    tokens.len = total;
+
+    // Sized for the worst case like LEXER_Tokenize(), so that tokens can be
+    // added later without moving these, see LEXER_TokenizeInto().
+    size cap = code.len + 1;
+    if (!ARENA_InitializeVirtual(&tokens.arena, TOKEN_BUFFER_RESERVE(cap))) ARENA_ExitOutOfMemory();
+    tokens.kinds = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint8), sizeof(uint8));
+    tokens.offsets = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    tokens.lengths = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    tokens.values = ARENA_AllocAlignedNoZero(&tokens.arena, cap * sizeof(uint32), sizeof(uint32));
+    tokens.cap = cast(uint32) cap;
+    if (!tokens.kinds || !tokens.offsets || !tokens.lengths || !tokens.values) ARENA_ExitOutOfMemory();
+
+    for (uint c = 0; c < thread_count; ++c) chunks[c].output = &tokens;
+    for (uint c = 1; c < thread_count; ++c) THREAD_Start(&threads[c], LEXER_StitchChunk, &chunks[c]);
+    LEXER_StitchChunk(&chunks[0]);
+    for (uint c = 1; c < thread_count; ++c) THREAD_Join(&threads[c]);
+
+    tokens.kinds[total-1] = TK_EOF;
+    tokens.offsets[total-1] = cast(uint32) code.len;
+    tokens.lengths[total-1] = 0;
+    tokens.values[total-1] = 0;
+
+    for (uint c = 0; c < thread_count; ++c) {
+        TOKEN_ReleaseBuffer(&chunks[c].tokens);
+        LEXER_Destroy(&chunks[c].lexer);
+    }
+    ARENA_ReleaseScratch(scratch);
+
+    lexer->cur_pos = code.len;
+    lexer->next_pos = code.len;
+    return tokens;
+}
+
+// Moves the tokens to arrays with room for `cap` of them.
+static void TOKEN_GrowBuffer(token_buffer_t* tokens, uint32 cap)
+{
+    arena_t arena;
+    if (!ARENA_InitializeVirtual(&arena, TOKEN_BUFFER_RESERVE(cast(size) cap))) ARENA_ExitOutOfMemory();
+
+    uint8* kinds = ARENA_AllocAlignedNoZero(&arena, cap * sizeof(uint8), sizeof(uint8));
+    uint32* offsets = ARENA_AllocAlignedNoZero(&arena, cap * sizeof(uint32), sizeof(uint32));
+    uint32* lengths = ARENA_AllocAlignedNoZero(&arena, cap * sizeof(uint32), sizeof(uint32));
+    uint32* values = ARENA_AllocAlignedNoZero(&arena, cap * sizeof(uint32), sizeof(uint32));
+    if (!kinds || !offsets || !lengths || !values) ARENA_ExitOutOfMemory();
+
+    memcpy(kinds, tokens->kinds, tokens->len * sizeof(uint8));
+    memcpy(offsets, tokens->offsets, tokens->len * sizeof(uint32));
+    memcpy(lengths, tokens->lengths, tokens->len * sizeof(uint32));
+    memcpy(values, tokens->values, tokens->len * sizeof(uint32));
+    ARENA_Release(&tokens->arena);
+
+    tokens->kinds = kinds;
+    tokens->offsets = offsets;
+    tokens->lengths = lengths;
+    tokens->values = values;
+    tokens->cap = cap;
+    tokens->arena = arena;
+}
+
+// Lexes the rest of the lexer's source onto the end of `tokens`, TK_EOF
+// included. Their offsets are relative to the lexer's source, not to
+// whatever the buffer already holds.
+void LEXER_TokenizeInto(lexer_t* lexer, token_buffer_t* tokens)
+{
+    assert(lexer->code.len <= LEXER_MAX_SOURCE_SIZE);
+
+    // Same worst case as LEXER_Tokenize(), but growing by half at least, so
+    // that many small sources appended one after the other rarely copy.
+    size needed = lexer->code.len - lexer->next_pos + 1;
+    if (tokens->cap - tokens->len < needed) {
+        size cap = tokens->len + needed;
+        if (cap < cast(size) tokens->cap + tokens->cap / 2) cap = cast(size) tokens->cap + tokens->cap / 2;
+        if (cap > UINT32_MAX) cap = UINT32_MAX;
+        assert(cap - tokens->len >= needed);
+        TOKEN_GrowBuffer(tokens, cast(uint32) cap);
+    }
+
+    while (true) {
+        token_t token = LEXER_ConsumeToken(lexer);
+        uint32 i = tokens->len++;
+
+        tokens->kinds[i] = cast(uint8) token.kind;
+        tokens->offsets[i] = token.offset;
+        tokens->lengths[i] = token.length;
+        tokens->values[i] = lexer->value;
+        if (token.kind == TK_EOF) break;
+    }
+}
+
+void TOKEN_DumpBuffer(token_buffer_t* tokens)
+{
+    // Without the TK_EOF that ends every buffer.
+    for (uint32 i = 0; i + 1 < tokens->len; ++i) {
+        TOKEN_Dump(TOKEN_FromBuffer(tokens, i), tokens->code);
+    }
+}
+
+void TOKEN_ReleaseBuffer(token_buffer_t* tokens)
+{
+    ARENA_Release(&tokens->arena);
+    tokens->len = 0;
+}
+
+string_t TOKEN_Literal(token_t token, string_t code)
+{
+    assert(token.offset + token.length <= code.len);
+    return STRING_SIZED(code.data + token.offset, token.length);
+}
+
+void TOKEN_Dump(token_t token, string_t code) {
+    string_t literal = TOKEN_Literal(token, code);
+    TRACE_Printf("token_t [%s] (literal='%.*s')\n", token_names[token.kind], cast(int) literal.len, literal.data);
+}
+
+void LEXER_BuildLineIndex(lexer_t* lexer)
+{
+    if (lexer->line_offsets != null) return;
+
+    // Count first, so that the index is allocated exactly once. Both passes
+    // go through the vectorized STRING_FindByte().
+    string_t code = lexer->code;
+    uint32 lines_len = 1;
+    for (size i = STRING_FindByte(code, 0, '\n'); i < code.len; i = STRING_FindByte(code, i+1, '\n')) {
+        lines_len += 1;
+    }
+
+    if (!ARENA_InitializeVirtual(&lexer->lines_arena, lines_len * sizeof(uint32))) ARENA_ExitOutOfMemory();
+
+    uint32* line_offsets = ARENA_AllocAlignedNoZero(&lexer->lines_arena, lines_len * sizeof(uint32), sizeof(uint32));
+    if (!line_offsets) ARENA_ExitOutOfMemory();
+
+    uint32 line = 0;
+    line_offsets[line++] = 0;
+    for (size i = STRING_FindByte(code, 0, '\n'); i < code.len; i = STRING_FindByte(code, i+1, '\n')) {
+        line_offsets[line++] = cast(uint32) (i + 1);
+    }
+
+    lexer->line_offsets = line_offsets;
+    lexer->lines_len = lines_len;
+}
+
+source_location_t LEXER_GetLocation(lexer_t* lexer, uint32 offset)
+{
+    // Only diagnostics ask for locations, so the index is built on demand.
+    LEXER_BuildLineIndex(lexer);
+
+    // Find the last line that starts at or before the offset.
+    uint32 low = 0;
+    uint32 high = lexer->lines_len;
+    while (high - low > 1) {
+        uint32 middle = low + (high - low) / 2;
+        if (lexer->line_offsets[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    source_location_t location;
+    location.line = low + 1;
+    location.column = offset - lexer->line_offsets[low] + 1;
+    return location;
 }
@@ -22,6 +22,20 @@
 #ifndef LEX_H
 #define LEX_H
 
+// Every keyword, as X(kind, spelling, first character, last character, name).
+// The token kinds, their names and the lexer's keyword table are all made from
+// this list. The first and last characters have to be spelled out, because
+// indexing a string literal is not a constant expression.
+#define KEYWORDS(X) \
+    X(TK_STRUCT, "struct", 's', 't', "a struct keyword") \
+    X(TK_ENUM,   "enum",   'e', 'm', "an enum keyword") \
+    X(TK_IF,     "if",     'i', 'f', "an if keyword") \
+    X(TK_ELSE,   "else",   'e', 'e', "an else keyword") \
+    X(TK_RETURN, "return", 'r', 'n', "a return keyword") \
+    X(TK_FOR,    "for",    'f', 'r', "a for keyword") \
+    X(TK_VAR,    "var",    'v', 'r', "a variable keyword") \
+    X(TK_FUN,    "fun",    'f', 'n', "a function keyword")
+
 enum token_kind
 {
     TK_UNKNOWN,
@@ -37,6 +51,7 @@ enum token_kind
     TK_COLON, // :
     TK_SEMICOLON, // ;
     TK_QUESTION_MARK, // ?
+    TK_EXCLAMATION_MARK, // !
     TK_BACKTICK, // `
     TK_EQUALS, // =
     TK_GREATER_THAN, // >
@@ -70,19 +85,16 @@ enum token_kind
     TK_STRING_LITERAL,
 
     // Keywords
-    TK_STRUCT,
-    TK_ENUM,
-    TK_IF,
-    TK_ELSE,
-    TK_RETURN,
-    TK_FOR,
-    TK_VAR,
-    TK_FUN,
+#define X(kind, spelling, first, last, name) kind,
+    KEYWORDS(X)
+#undef X
 
     TK_IDENTIFIER,
 
     TK_ILLEGAL,
     TK_EOF,
+
+    TK_COUNT,
 };
 typedef enum token_kind token_kind_t;
 
@@ -100,6 +112,8 @@ static const char* token_names[] = {
     [TK_COLON] = "a colon",
     [TK_SEMICOLON] = "a semicolon",
     [TK_QUESTION_MARK] = "a question mark",
+    [TK_EXCLAMATION_MARK] = "an exclamation mark",
+    [TK_BACKTICK] = "a backtick",
     [TK_EQUALS] = "an equals sign",
     [TK_GREATER_THAN] = "a greater than sign",
     [TK_LESS_THAN] = "a less than sign",
@@ -127,14 +141,9 @@ static const char* token_names[] = {
     [TK_STRING_LITERAL] = "a string literal",
 
     // Keywords
-    [TK_STRUCT] = "a struct keyword",
-    [TK_ENUM] = "an enum keyword",
-    [TK_IF] = "an if keyword",
-    [TK_ELSE] = "an else keyword",
-    [TK_RETURN] = "a return keyword",
-    [TK_FOR] = "a for keyword",
-    [TK_VAR] = "a variable keyword",
-    [TK_FUN] = "a function keyword",
+#define X(kind, spelling, first, last, name) [kind] = name,
+    KEYWORDS(X)
+#undef X
 
     [TK_IDENTIFIER] = "an identifier",
 
@@ -142,29 +151,128 @@ static const char* token_names[] = {
     [TK_ILLEGAL] = "an illegal token",
 };
 
+// Tokens only know where they are in the source, see TOKEN_Literal() and
+// LEXER_GetLocation() for their text and their line and column.
+#define TOKEN_MAX_LENGTH ((1u << 24) - 1)
 struct token
 {
-    token_kind_t kind; 
-    string_t literal;
-    // @TODO: remove these and use a pointer to location instead
-    uint column;
-    uint line;
+    uint32 offset;
+    uint32 length : 24;
+    uint32 kind   : 8;
 };
 typedef struct token token_t;
 
+enum number_kind
+{
+    NUMBER_INTEGER, // [0-9]+
+    NUMBER_FLOAT,   // [0-9]+ '.' [0-9]*
+};
+typedef enum number_kind number_kind_t;
+
+// The value of a number literal, converted once by the lexer.
+struct number
+{
+    union {
+        uint64 integer;
+        float64 real;
+    };
+    number_kind_t kind;
+    bool overflow; // Too big for its kind, the value is meaningless then.
+};
+typedef struct number number_t;
+
+// 1-based, columns are counted in bytes.
+struct source_location
+{
+    uint32 line;
+    uint32 column;
+};
+typedef struct source_location source_location_t;
+
 struct lexer
 {
     char current;
     uint64 cur_pos;
     uint64 next_pos;
 
+    // Must be followed by IO_SOURCE_PADDING zero bytes, see IO_OpenFile().
     string_t code;
 
+    // Values of every number literal, in order. They are the only thing in
+    // the literal arena, so they can always grow in place.
     arena_t literal_arena;
+    number_t* numbers;
+    uint32 numbers_len;
+    uint32 numbers_cap;
+
+    intern_table_t symbols;
+
+    // Of the last token LEXER_ConsumeToken() returned, see token_buffer_t.
+    uint32 value;
+
+    // Where every line starts, only built once a location is asked for.
+    uint32* line_offsets;
+    uint32 lines_len;
+    arena_t lines_arena;
+
+    // Intern copies of identifiers rather than views into the source, for
+    // sources that do not outlive the lexer, see DOCUMENT_ApplyEdit().
+    bool copy_symbols;
 };
 typedef struct lexer lexer_t;
 
-void TOKEN_Dump(token_t* token);
+// A whole file lexed up front, as parallel arrays indexed by token number.
+// Deciding what to parse only needs the kinds, which are packed on their own.
+// Literals are (offset, length) slices of `code`. The last token is always
+// TK_EOF, so looking ahead can never run off the end.
+struct token_buffer
+{
+    string_t code;
+
+    uint8* kinds;
+    uint32* offsets;
+    uint32* lengths;
+    uint32* values; // Identifiers: symbol_t, number literals: index into the
+                    // lexer's `numbers`, everything else: 0.
+    uint32 len;
+    uint32 cap; // Room in each array, in tokens.
+
+    arena_t arena;
+};
+typedef struct token_buffer token_buffer_t;
+
+// Address space for the arrays of a token buffer with room for `cap` tokens,
+// plus what aligning them can waste.
+#define TOKEN_BUFFER_RESERVE(cap) ((cap) * (sizeof(uint8) + 3*sizeof(uint32)) + sizeof(uint32))
+
+// Token offsets are 32 bits wide, and the end of the source is the offset of
+// its TK_EOF. Callers have to reject anything bigger before lexing it.
+#define LEXER_MAX_SOURCE_SIZE (cast(size) UINT32_MAX - 1)
+
+// Files are only split into chunks at least this big, so small files are
+// lexed serially.
+#define LEXER_MIN_CHUNK_SIZE (cast(size) 1 << 20)
+#define LEXER_MAX_THREADS 64
+
+// One thread's share of LEXER_TokenizeParallel().
+struct lexer_chunk
+{
+    lexer_t lexer; // Interns into a symbol table of its own.
+    token_buffer_t tokens;
+
+    symbol_t* symbol_map;  // Chunk symbol -> symbol in the file's lexer.
+    uint32 number_offset;  // Index of the chunk's first number in the file's lexer.
+    token_buffer_t* output;
+    uint32 output_offset;  // Index of the chunk's first token in `output`.
+    bool release_scratch;  // Whether it runs on a thread of its own.
+};
+typedef struct lexer_chunk lexer_chunk_t;
+
+void TOKEN_Dump(token_t token, string_t code);
+string_t TOKEN_Literal(token_t token, string_t code);
+void TOKEN_DumpBuffer(token_buffer_t* tokens);
+token_t TOKEN_FromBuffer(token_buffer_t* tokens, uint32 index);
+void TOKEN_ReleaseBuffer(token_buffer_t* tokens);
 
 lexer_t LEXER_Create(string_t code);
 void LEXER_Destroy(lexer_t* lexer);
@@ -174,6 +282,16 @@ bool LEXER_Match(lexer_t* lexer, char character);
 
 token_t LEXER_ConsumeToken(lexer_t* lexer);
 token_t LEXER_ConsumeNumber(lexer_t* lexer);
+void LEXER_ReserveNumbers(lexer_t* lexer, uint32 count);
+uint32 LEXER_AddNumber(lexer_t* lexer, number_t number);
 token_t LEXER_ConsumeString(lexer_t* lexer);
+token_buffer_t LEXER_Tokenize(lexer_t* lexer);
+void LEXER_TokenizeChunk(void* chunk);
+void LEXER_StitchChunk(void* chunk);
+token_buffer_t LEXER_TokenizeParallel(lexer_t* lexer, uint thread_count);
+void LEXER_TokenizeInto(lexer_t* lexer, token_buffer_t* tokens);
+
+void LEXER_BuildLineIndex(lexer_t* lexer);
+source_location_t LEXER_GetLocation(lexer_t* lexer, uint32 offset);
 
 #endif // LEX_H
@@ -19,311 +19,849 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-// @TODO: may want to use dynamic alloc
-#define PARSER_NODE_LIMIT 131072
-static byte* node_buffer[PARSER_NODE_LIMIT];
-
-parser_t PARSER_Create(lexer_t* lexer)
+parser_t PARSER_Create(lexer_t* lexer, token_buffer_t* tokens)
 {
-    arena_t node_arena;
-    ARENA_Initialize(&node_arena, node_buffer, PARSER_NODE_LIMIT);
+    assert(tokens->len > 0);
 
     parser_t parser;
     parser.lexer = lexer;
-    parser.node_arena = node_arena;
-    PARSER_ConsumeToken(&parser);
-    PARSER_ConsumeToken(&parser);
+    parser.tokens = tokens;
+    parser.cursor = 0;
+    parser.lazy_bodies = false;
+    parser.panicking = false;
+    parser.error_token = 0;
+    parser.depth = 0;
+    AST_Initialize(&parser.ast);
     return parser;
 }
 
 void PARSER_Destroy(parser_t* parser)
 {
     LEXER_Destroy(parser->lexer);
-    ARENA_Free(&parser->node_arena);
+    AST_Release(&parser->ast);
 }
 
-bool PARSER_TokenKindIsOperator(token_kind_t kind)
+// Every token an expression can contain, indexed by kind. Higher powers bind
+// tighter; tokens without a prefix handler are read as plain operands.
+static const parser_operator_t parser_operators[TK_COUNT] = {
+    [TK_LOGICAL_OR]             = { null, PARSER_InfixBinary, 0, 1, ASSOC_LEFT },
+    [TK_LOGICAL_AND]            = { null, PARSER_InfixBinary, 0, 2, ASSOC_LEFT },
+    [TK_DOUBLE_EQUALS]          = { null, PARSER_InfixBinary, 0, 3, ASSOC_LEFT },
+    [TK_NOT_EQUALS]             = { null, PARSER_InfixBinary, 0, 3, ASSOC_LEFT },
+    [TK_LESS_THAN]              = { null, PARSER_InfixBinary, 0, 4, ASSOC_LEFT },
+    [TK_GREATER_THAN]           = { null, PARSER_InfixBinary, 0, 4, ASSOC_LEFT },
+    [TK_LESS_OR_EQUALS_TO]      = { null, PARSER_InfixBinary, 0, 4, ASSOC_LEFT },
+    [TK_GREATER_OR_EQUALS_TO]   = { null, PARSER_InfixBinary, 0, 4, ASSOC_LEFT },
+    [TK_PLUS]                   = { null, PARSER_InfixBinary, 0, 5, ASSOC_LEFT },
+    [TK_MINUS]                  = { PARSER_PrefixUnary, PARSER_InfixBinary, 7, 5, ASSOC_LEFT },
+    [TK_ASTERISK]               = { null, PARSER_InfixBinary, 0, 6, ASSOC_LEFT },
+    [TK_SLASH]                  = { null, PARSER_InfixBinary, 0, 6, ASSOC_LEFT },
+    [TK_EXCLAMATION_MARK]       = { PARSER_PrefixUnary, null, 7, 0, ASSOC_UNKNOWN },
+    [TK_EXPONENT]               = { null, PARSER_InfixBinary, 0, 8, ASSOC_RIGHT },
+    [TK_PARENTHESIS_OPEN]       = { PARSER_PrefixGroup, null, 0, 0, ASSOC_UNKNOWN },
+    [TK_PARENTHESIS_CLOSE]      = { null, PARSER_InfixCloseGroup, 0, 0, ASSOC_UNKNOWN },
+};
+
+static force_inline bool PARSER_StartsExpression(token_kind_t kind)
 {
-    return kind == TK_PLUS
-        || kind == TK_MINUS
-        || kind == TK_ASTERISK
-        || kind == TK_SLASH
-        || kind == TK_EXPONENT;
+    return kind == TK_NUMBER_LITERAL || kind == TK_STRING_LITERAL || kind == TK_IDENTIFIER
+        || parser_operators[kind].prefix != null;
 }
 
-uint PARSER_OperatorPrecedence(token_kind_t op)
+void PARSER_ConsumeToken(parser_t* parser)
 {
-    // Based on Pratt's parser logic.
-    switch (op) {
-        case TK_MINUS:
-        case TK_PLUS:
-            return 1;
-        case TK_ASTERISK:
-        case TK_SLASH:
-            return 2;
-        case TK_EXPONENT:
-            return 3;
-        default:
-            return 0;
-    }
+    // Illegal tokens are consumed like any other, they are reported wherever
+    // they do not fit.
+    if (parser->tokens->kinds[parser->cursor] == TK_EOF)
+        return;
+
+    parser->cursor += 1;
+}
+
+uint32 PARSER_TokenIndex(parser_t* parser, uint32 ahead)
+{
+    // Everything past the end reads as the TK_EOF that ends every buffer.
+    uint32 index = parser->cursor + ahead;
+    return index < parser->tokens->len ? index : parser->tokens->len - 1;
+}
+
+token_kind_t PARSER_PeekKind(parser_t* parser, uint32 ahead)
+{
+    return parser->tokens->kinds[PARSER_TokenIndex(parser, ahead)];
 }
 
-operator_associativity_type_t PARSER_OperatorAssociativity(token_kind_t op)
+number_t PARSER_PeekNumber(parser_t* parser, uint32 ahead)
 {
-    switch (op) {
-        case TK_MINUS:
-        case TK_PLUS:
-        case TK_ASTERISK:
-        case TK_SLASH:
-            return ASSOC_LEFT;
-        case TK_EXPONENT:
-            return ASSOC_RIGHT;
-        default:
-            return ASSOC_UNKNOWN;
+    uint32 index = PARSER_TokenIndex(parser, ahead);
+    assert(parser->tokens->kinds[index] == TK_NUMBER_LITERAL);
+    return parser->lexer->numbers[parser->tokens->values[index]];
+}
+
+// Moves the cursor onto the next token if it is of `kind`, or reports it.
+bool PARSER_Expect(parser_t* parser, token_kind_t kind)
+{
+    uint32 token = PARSER_TokenIndex(parser, 1);
+    if (parser->tokens->kinds[token] != kind) {
+        PARSER_ReportError(parser, token, kind);
+        return false;
     }
+
+    parser->cursor = token;
+    return true;
 }
 
-void PARSER_ConsumeToken(parser_t* parser)
+// Reports `token` as unexpected, unless the statement already has an error:
+// whatever follows the first one is most likely a consequence of it.
+void PARSER_ReportError(parser_t* parser, uint32 token, token_kind_t expected)
 {
-    parser->current_token = parser->next_token;
-    if (parser->current_token.kind == TK_ILLEGAL || parser->current_token.kind == TK_EOF)
-        return;
+    if (parser->panicking) return;
+
+    parser->panicking = true;
+    parser->error_token = token;
+
+    scoped_error_t error = ERROR_MakeScoped();
+    error.error_kind = ERRORK_UNEXPECTED_TOKEN;
+    error.token = TOKEN_FromBuffer(parser->tokens, token);
+    error.expected = expected;
+    ERROR_Report(&error, parser->lexer);
+}
+
+// Marks where the statement went wrong in the tree, keeping what was parsed.
+ast_handle_t PARSER_AddError(parser_t* parser, ast_handle_t partial)
+{
+    assert(parser->panicking);
+    return AST_AddNode(&parser->ast, ASTK_ERROR, parser->error_token, partial, AST_NONE);
+}
 
-    parser->next_token = LEXER_ConsumeToken(parser->lexer);
+// Panic-mode recovery for the statement that started at `start`: skips to the
+// `;` or `}` that ends it, or to just before the next declaration or the `}`
+// of the enclosing block, and leaves the cursor on its last token.
+void PARSER_Synchronize(parser_t* parser, uint32 start)
+{
+    assert(parser->panicking);
+    TRACE_PRINTF(TRACE_PARSE, TRACE_LEVEL_INFO, "parse: synchronizing after token %u\n", parser->error_token);
+
+    uint8* kinds = parser->tokens->kinds;
+    uint32 depth = 0;
+    uint32 token = parser->error_token;
+    uint32 last = token;
+
+    while (true) {
+        token_kind_t kind = kinds[token];
+        if (kind == TK_EOF) {
+            last = token > start ? token - 1 : token;
+            break;
+        }
+
+        if (kind == TK_CURLY_BRACE_OPEN) {
+            depth += 1;
+        } else if (kind == TK_CURLY_BRACE_CLOSE) {
+            if (depth == 0) {
+                last = token > start ? token - 1 : token;
+                break;
+            }
+            if (--depth == 0) {
+                last = token;
+                break;
+            }
+        } else if (depth == 0) {
+            if (kind == TK_SEMICOLON) {
+                last = token;
+                break;
+            }
+            if (kind == TK_FUN || kind == TK_STRUCT || kind == TK_ENUM || kind == TK_VAR) {
+                last = token > start ? token - 1 : token;
+                break;
+            }
+        }
+
+        token += 1;
+    }
+
+    // Always take at least the token the statement started at, and never
+    // give back what it already read.
+    if (last < start) last = start;
+    if (last < parser->cursor) last = parser->cursor;
+
+    parser->cursor = last;
+    parser->panicking = false;
 }
 
 void PARSER_Parse(parser_t* parser)
 {
-    ast_program_t program = AST_CreateProgramNode();
+    // The statements only become a list in `extra` at the end, since parsing
+    // them adds to `extra` too. Until then they are collected in a scratch
+    // arena, which everything below allocates from as well.
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t statements;
+    VECTOR_Initialize(&statements, scratch.arena, sizeof(ast_handle_t));
+
+    PARSER_ParseTopLevel(parser, parser->tokens->len, &statements);
+    PARSER_FinishProgram(parser, &statements);
+    ARENA_ReleaseScratch(scratch);
+
+    if (TRACE_IS_ENABLED(TRACE_AST, TRACE_LEVEL_INFO)) PARSER_DumpAST(parser);
+    return;
+}
 
-    while (parser->current_token.kind != TK_EOF) {
-        ast_statement_t* stmt = PARSER_ParseStatement(parser);
+// Parses statements until the next one would start at or after `end`, or at
+// the end of the file, and leaves the cursor where it would start.
+void PARSER_ParseTopLevel(parser_t* parser, uint32 end, segmented_vector_t* statements)
+{
+    while (parser->cursor < end && PARSER_PeekKind(parser, 0) != TK_EOF) {
+        ast_handle_t stmt = PARSER_ParseStatement(parser);
 
-        if (stmt != NULL) {
-            program.statements[program.statements_len++] = stmt;
+        if (stmt != AST_NONE) {
+            *cast(ast_handle_t*) VECTOR_Push(statements) = stmt;
         }
 
         // @TODO: we may want to reduce all tokens, not just 1?
         PARSER_ConsumeToken(parser);
     }
-    
-    PARSER_DumpAST(parser, &program);
-    return;
 }
 
-ast_statement_t* PARSER_ParseStatement(parser_t* parser)
+void PARSER_FinishProgram(parser_t* parser, segmented_vector_t* statements)
+{
+    uint32 first = AST_AddExtra(&parser->ast, null, statements->len);
+    VECTOR_CopyTo(statements, parser->ast.extra + first);
+    parser->ast.root = AST_AddNode(&parser->ast, ASTK_PROGRAM, parser->cursor, first, statements->len);
+}
+
+void PARSER_ParseChunk(void* data)
 {
-    ast_statement_t* stmt = AST_CREATE_NODE(&parser->node_arena);
-    assert(stmt);
+    parser_chunk_t* chunk = cast(parser_chunk_t*) data;
+    parser_t* parser = &chunk->parser;
+
+    // Errors are only printed once it is known that the serial parser would
+    // have run into them too, see PARSER_ParseParallel().
+    ERROR_BeginDeferred(&chunk->errors, &chunk->error_arena);
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t statements;
+    VECTOR_Initialize(&statements, scratch.arena, sizeof(ast_handle_t));
+
+    parser->cursor = chunk->begin;
+    PARSER_ParseTopLevel(parser, chunk->end, &statements);
+    chunk->stop = parser->cursor;
+
+    // The chunk's statements go last, as its own program, so that merging can
+    // take everything before them as is.
+    PARSER_FinishProgram(parser, &statements);
+    ARENA_ReleaseScratch(scratch);
+
+    ERROR_EndDeferred();
+    if (chunk->release_scratch) ARENA_ReleaseThreadScratch();
+}
+
+void PARSER_MergeChunk(void* data)
+{
+    parser_chunk_t* chunk = cast(parser_chunk_t*) data;
+    ast_t* chunk_ast = &chunk->parser.ast;
+    ast_handle_t root = chunk_ast->root;
+
+    AST_CopyFrom(chunk->output, chunk->output_node, chunk->output_extra, chunk_ast, root, chunk_ast->lhs[root]);
+
+    uint32 offset = chunk->output_node - 1;
+    ast_handle_t* statements = chunk_ast->extra + chunk_ast->lhs[root];
+    ast_handle_t* output = chunk->output->extra + chunk->output_statement;
+    for (uint32 s = 0; s < chunk_ast->rhs[root]; ++s) {
+        output[s] = statements[s] + offset;
+    }
+
+    AST_Release(chunk_ast);
+    ARENA_Release(&chunk->error_arena);
+    if (chunk->release_scratch) ARENA_ReleaseThreadScratch();
+}
+
+// Parses like PARSER_Parse(), and builds exactly the same tree, but splits
+// the top-level statements between up to `thread_count` threads.
+void PARSER_ParseParallel(parser_t* parser, uint thread_count)
+{
+    token_buffer_t* tokens = parser->tokens;
+
+    uint32 max_chunks = tokens->len / PARSER_MIN_CHUNK_TOKENS;
+    if (thread_count > max_chunks) thread_count = max_chunks;
+    if (thread_count > PARSER_MAX_THREADS) thread_count = PARSER_MAX_THREADS;
+
+    // Tracing prints as it parses, which only makes sense in order.
+    if (thread_count <= 1 || TRACE_IS_ENABLED(TRACE_PARSE, TRACE_LEVEL_INFO)) {
+        PARSER_Parse(parser);
+        return;
+    }
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    parser_chunk_t* chunks = ARENA_Alloc(scratch.arena, thread_count * sizeof(parser_chunk_t));
+    thread_t threads[PARSER_MAX_THREADS];
+    if (!chunks) ARENA_ExitOutOfMemory();
+
+    // Move each even split forward to the first token after a `;` or `}` at
+    // brace depth 0, where a declaration or assignment has just ended. That
+    // is only a guess of where the serial parser starts a statement, which
+    // the merge below checks.
+    const uint8* kinds = tokens->kinds;
+    uint32 last = tokens->len - 1;
+    uint32 depth = 0;
+    uint32 i = 0;
+    uint32 begin = 0;
+    for (uint c = 0; c < thread_count; ++c) {
+        uint32 end = tokens->len;
+        if (c + 1 < thread_count) {
+            uint32 split = cast(uint32) (cast(uint64) last * (c + 1) / thread_count);
+            while (i < last) {
+                token_kind_t kind = kinds[i++];
+                depth += kind == TK_CURLY_BRACE_OPEN;
+                depth -= kind == TK_CURLY_BRACE_CLOSE && depth > 0;
+                if (i >= split && depth == 0 && (kind == TK_SEMICOLON || kind == TK_CURLY_BRACE_CLOSE)) break;
+            }
+            end = i;
+        }
+
+        parser_chunk_t* chunk = &chunks[c];
+        chunk->parser = PARSER_Create(parser->lexer, tokens);
+        chunk->parser.lazy_bodies = parser->lazy_bodies;
+        chunk->begin = begin;
+        chunk->end = end;
+        chunk->stop = begin;
+        chunk->release_scratch = c > 0;
+        if (!ARENA_InitializeDefault(&chunk->error_arena)) ARENA_ExitOutOfMemory();
+        begin = end;
+    }
+
+    // The calling thread takes the first chunk itself. A chunk whose thread
+    // did not start runs on the calling thread too, which keeps its scratch.
+    for (uint c = 1; c < thread_count; ++c) {
+        if (!THREAD_Start(&threads[c], PARSER_ParseChunk, &chunks[c])) chunks[c].release_scratch = false;
+    }
+    PARSER_ParseChunk(&chunks[0]);
+    for (uint c = 1; c < thread_count; ++c) THREAD_Join(&threads[c]);
+
+    // A chunk is what the serial parser would have built if the statement
+    // before it ended right where the chunk begins. Otherwise it is parsed
+    // again, here, from where that statement did end. Either way its errors
+    // can be printed then, in order.
+    uint32 cursor = 0;
+    for (uint c = 0; c < thread_count; ++c) {
+        parser_chunk_t* chunk = &chunks[c];
+        if (chunk->begin != cursor) {
+            AST_Release(&chunk->parser.ast);
+            AST_Initialize(&chunk->parser.ast);
+            ARENA_Free(&chunk->error_arena);
+            chunk->begin = cursor;
+            chunk->release_scratch = false;
+            PARSER_ParseChunk(chunk);
+        }
+
+        ERROR_ReportDeferred(&chunk->errors, parser->lexer);
+        cursor = chunk->stop;
+    }
+
+    // Lay the chunks out one after the other, each without its own program
+    // node and list, with the statements of all of them in one list last.
+    ast_t* ast = &parser->ast;
+    uint32 nodes_len = 0;
+    uint32 extra_len = 0;
+    uint32 statements_len = 0;
+    for (uint c = 0; c < thread_count; ++c) {
+        ast_t* chunk_ast = &chunks[c].parser.ast;
+        nodes_len += chunk_ast->root - 1;
+        extra_len += chunk_ast->lhs[chunk_ast->root];
+        statements_len += chunk_ast->rhs[chunk_ast->root];
+    }
+
+    ast_handle_t node = AST_ReserveNodes(ast, nodes_len);
+    uint32 extra = AST_AddExtra(ast, null, extra_len + statements_len);
+    uint32 statement = extra + extra_len;
+    for (uint c = 0; c < thread_count; ++c) {
+        parser_chunk_t* chunk = &chunks[c];
+        ast_t* chunk_ast = &chunk->parser.ast;
+        chunk->output = ast;
+        chunk->output_node = node;
+        chunk->output_extra = extra;
+        chunk->output_statement = statement;
+        chunk->release_scratch = c > 0;
+        node += chunk_ast->root - 1;
+        extra += chunk_ast->lhs[chunk_ast->root];
+        statement += chunk_ast->rhs[chunk_ast->root];
+    }
+
+    for (uint c = 1; c < thread_count; ++c) {
+        if (!THREAD_Start(&threads[c], PARSER_MergeChunk, &chunks[c])) chunks[c].release_scratch = false;
+    }
+    PARSER_MergeChunk(&chunks[0]);
+    for (uint c = 1; c < thread_count; ++c) THREAD_Join(&threads[c]);
+
+    parser->cursor = cursor;
+    ast->root = AST_AddNode(ast, ASTK_PROGRAM, cursor, statement - statements_len, statements_len);
+    ARENA_ReleaseScratch(scratch);
+
+    if (TRACE_IS_ENABLED(TRACE_AST, TRACE_LEVEL_INFO)) PARSER_DumpAST(parser);
+}
+
+// Index of the `}` that closes the `{` at `open`, or of the TK_EOF when it
+// is never closed. Only looks at token kinds, so skipping a body costs about
+// a byte per token.
+uint32 PARSER_MatchBrace(parser_t* parser, uint32 open)
+{
+    assert(parser->tokens->kinds[open] == TK_CURLY_BRACE_OPEN);
+
+    const uint8* kinds = parser->tokens->kinds;
+    uint32 last = parser->tokens->len - 1;
+    uint32 depth = 0;
+    for (uint32 i = open; i < last; ++i) {
+        depth += kinds[i] == TK_CURLY_BRACE_OPEN;
+        depth -= kinds[i] == TK_CURLY_BRACE_CLOSE;
+        if (depth == 0) return i;
+    }
+
+    return last;
+}
+
+// Parses the body of a function the first time it is asked for. Lazy
+// parsers leave every body for this; eager ones have already parsed them.
+ast_handle_t PARSER_GetFunctionBody(parser_t* parser, ast_handle_t function)
+{
+    ast_function_t* record = AST_GetFunction(&parser->ast, function);
+    if (record->body != AST_NONE || record->body_open == 0) {
+        return record->body;
+    }
 
-    stmt->kind = ASTK_STMT;
+    uint32 depth = parser->depth;
+    parser->depth = record->depth + 1;
+    ast_handle_t body = PARSER_ParseBlock(parser, record->body_open, record->body_close);
+    parser->depth = depth;
 
-    // @TODO: Check if these micro allocations are a bit too much.
-    byte* scratch_node_buffer[16384];
-    arena_t scratch;
-    ARENA_Initialize(&scratch, scratch_node_buffer, 16384);
+    // Parsing the body grows `extra`, so the record has to be looked up again.
+    AST_GetFunction(&parser->ast, function)->body = body;
+    return body;
+}
+
+ast_handle_t PARSER_ParseStatement(parser_t* parser)
+{
+    ast_handle_t stmt = AST_NONE;
+    uint32 start = PARSER_TokenIndex(parser, 0);
+    token_kind_t kind = parser->tokens->kinds[start];
 
-    if (parser->current_token.kind == TK_NUMBER_LITERAL) {
-        stmt = PARSER_ParseExpression(parser, 0, &scratch);
-    } else if (parser->next_token.kind == TK_ASSIGNMENT_OPERATOR) {
-        stmt = PARSER_ParseAssignment(parser, &scratch);
-    } else if (parser->next_token.kind == TK_FUN) {
+    TRACE_PRINTF(TRACE_PARSE, TRACE_LEVEL_INFO, "parse: statement at token %u (%s)\n",
+                 parser->cursor, token_names[kind]);
+
+    if (kind == TK_FUN) {
         // @FIXME: We should separate "statements" from "declarations".
-        stmt = cast(ast_statement_t*) PARSER_ParseFunction(parser, &scratch);
+        stmt = PARSER_ParseFunction(parser);
+    } else if (kind == TK_IDENTIFIER && PARSER_PeekKind(parser, 1) == TK_ASSIGNMENT_OPERATOR) {
+        stmt = PARSER_ParseAssignment(parser);
+    } else if (kind == TK_SEMICOLON) {
+        // An empty statement.
+        stmt = AST_AddNode(&parser->ast, ASTK_STMT, start, AST_NONE, AST_NONE);
+    } else if (PARSER_StartsExpression(kind)) {
+        stmt = PARSER_ParseExpression(parser, 0);
+        if (!parser->panicking && !PARSER_Expect(parser, TK_SEMICOLON)) {
+            stmt = PARSER_AddError(parser, stmt);
+        }
+    } else {
+        PARSER_ReportError(parser, start, TK_UNKNOWN);
+        stmt = PARSER_AddError(parser, AST_NONE);
+    }
+
+    if (parser->panicking) {
+        PARSER_Synchronize(parser, start);
     }
 
     return stmt;
 }
 
-ast_statement_t* PARSER_ParseExpression(parser_t* parser, uint8 prec_limit, arena_t* scratch)
+ast_handle_t PARSER_ParseExpression(parser_t* parser, uint8 min_power)
 {
     // Implementation of a Pratt parser.
     // Wonderful article explaining this algorithm:
     // https://martin.janiczek.cz/2023/07/03/demystifying-pratt-parsers.html
-    ast_expression_t* expr = AST_CREATE_NODE(&parser->node_arena);
-    assert(expr);
+    // Instead of recursing for the right-hand side, pending operators wait on
+    // a stack, each holding its left operand, and are reduced by binding power
+    // into the current operand. The call stack does not grow with the input.
+    TRACE_PRINTF(TRACE_PARSE, TRACE_LEVEL_VERBOSE, "parse: expression at token %u, minimum power %u\n",
+                 parser->cursor, min_power);
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    parser_expression_t expr;
+    expr.arena = scratch.arena;
+    expr.operators = null;
+    expr.operators_len = 0;
+    expr.operators_cap = 0;
+    expr.operand = AST_NONE;
+    expr.open_groups = 0;
+    expr.min_power = min_power;
+    expr.expect_operand = true;
+
+    while (true) {
+        if (expr.expect_operand) {
+            uint32 token = PARSER_TokenIndex(parser, 0);
+            token_kind_t kind = parser->tokens->kinds[token];
+
+            if (parser_operators[kind].prefix) {
+                parser_operators[kind].prefix(parser, &expr, token);
+                PARSER_ConsumeToken(parser);
+                continue;
+            }
 
-    expr->kind = ASTK_EXPR;
-    expr->token = parser->current_token;
+            if (kind != TK_NUMBER_LITERAL && kind != TK_STRING_LITERAL && kind != TK_IDENTIFIER) {
+                // The operand is missing. The token is left to whatever
+                // comes after the expression, usually a `;` to sync to.
+                PARSER_ReportError(parser, token, TK_UNKNOWN);
+                expr.operand = AST_AddNode(&parser->ast, ASTK_ERROR, token, AST_NONE, AST_NONE);
+                parser->cursor = token - 1;
+                break;
+            }
 
-    while (PARSER_TokenKindIsOperator(parser->next_token.kind)) {
-        uint8 prec = PARSER_OperatorPrecedence(parser->next_token.kind);
-        uint8 final_prec = prec;
-        if (PARSER_OperatorAssociativity(parser->next_token.kind) == ASSOC_RIGHT) {
-            final_prec -= 1;
-        }
+            if (kind == TK_NUMBER_LITERAL && PARSER_PeekNumber(parser, 0).overflow) {
+                scoped_error_t error = ERROR_MakeScoped();
+                error.error_kind = ERRORK_NUMBER_OUT_OF_RANGE;
+                error.token = TOKEN_FromBuffer(parser->tokens, token);
+                ERROR_Report(&error, parser->lexer);
+            }
 
-        if (prec <= prec_limit) {
-            return expr;
+            expr.operand = AST_AddNode(&parser->ast, ASTK_EXPR, token, AST_NONE, AST_NONE);
+            expr.expect_operand = false;
+        } else {
+            // The cursor stays on the last token read until the next one is
+            // known to belong to the expression.
+            uint32 token = PARSER_TokenIndex(parser, 1);
+            parser_infix_fn_t infix = parser_operators[parser->tokens->kinds[token]].infix;
+            if (!infix || !infix(parser, &expr, token)) {
+                break;
+            }
         }
+    }
 
-        token_t op_token = parser->next_token;
+    // The groups still open are closed where the expression stopped.
+    bool unclosed = expr.open_groups > 0 && !parser->panicking;
+    if (unclosed) {
+        PARSER_ReportError(parser, PARSER_TokenIndex(parser, 1), TK_PARENTHESIS_CLOSE);
+    }
 
-        // Consume both the number and the operator.
-        PARSER_ConsumeToken(parser);
-        PARSER_ConsumeToken(parser);
+    while (expr.operators_len > 0) {
+        PARSER_ReduceOperator(parser, &expr);
+    }
 
-        ast_expression_t* right = PARSER_ParseExpression(parser, final_prec, scratch);
-        ast_binary_op_t* binop = AST_CREATE_NODE_SIZED(scratch, sizeof(ast_binary_op_t));
-        assert(binop);
+    if (unclosed) {
+        expr.operand = PARSER_AddError(parser, expr.operand);
+    }
+
+    ARENA_ReleaseScratch(scratch);
+    return expr.operand;
+}
 
-        binop->kind = ASTK_BINARY;
-        binop->left = expr;
-        binop->right = right;
-        binop->token = op_token;
+static force_inline parser_pending_operator_t* PARSER_PushOperator(parser_expression_t* expr)
+{
+    if (expr->operators_len == expr->operators_cap) {
+        uint32 new_cap = expr->operators_cap > 0 ? expr->operators_cap * 2 : 64;
+        expr->operators = ARENA_Resize(expr->arena, expr->operators,
+                                       expr->operators_cap * sizeof(parser_pending_operator_t),
+                                       new_cap * sizeof(parser_pending_operator_t));
+        if (!expr->operators) ARENA_ExitOutOfMemory();
+        expr->operators_cap = new_cap;
+    }
 
-        expr = cast(ast_expression_t*) binop;
-    };
+    return &expr->operators[expr->operators_len++];
+}
 
-    return expr;
+void PARSER_PrefixUnary(parser_t* parser, parser_expression_t* expr, uint32 token)
+{
+    parser_pending_operator_t* pending = PARSER_PushOperator(expr);
+    pending->token = token;
+    pending->lhs = AST_NONE;
+    pending->kind = ASTK_UNARY;
+    pending->power = parser_operators[parser->tokens->kinds[token]].prefix_power;
 }
 
-ast_statement_t* PARSER_ParseAssignment(parser_t* parser, arena_t* scratch)
+void PARSER_PrefixGroup(parser_t* parser, parser_expression_t* expr, uint32 token)
 {
-    // @TODO: specifying types (e.g. var a: uint = 42)
-    ast_declaration_t* decl = AST_CREATE_NODE_SIZED(&parser->node_arena, sizeof(ast_declaration_t));
-    assert(decl);
+    parser_pending_operator_t* pending = PARSER_PushOperator(expr);
+    pending->token = token;
+    pending->lhs = AST_NONE;
+    pending->kind = ASTK_GROUP;
+    pending->power = 0;
+    expr->open_groups += 1;
+}
 
-    // @TODO: Check if `var` is present.
+bool PARSER_InfixBinary(parser_t* parser, parser_expression_t* expr, uint32 token)
+{
+    parser_operator_t op = parser_operators[parser->tokens->kinds[token]];
+    if (expr->open_groups == 0 && op.infix_power <= expr->min_power) {
+        return false;
+    }
 
-    decl->kind = ASTK_VARIABLE_ASSIGNMENT;
-    decl->token = parser->next_token;
-    decl->variable.name_with_type = PARSER_ParseNameWithType(parser, scratch);
-    PARSER_ConsumeToken(parser); // Consume the assignment operator.
-    decl->variable.expression = PARSER_ParseExpression(parser, 0, scratch);
+    TRACE_PRINTF(TRACE_PARSE, TRACE_LEVEL_VERBOSE, "parse: operator %s at token %u, power %u\n",
+                 token_names[parser->tokens->kinds[token]], token, op.infix_power);
 
-    // Consume the semicolon.
-    // @TODO: Throw an error if the semicolon is not found.
-    PARSER_ConsumeToken(parser);
+    // Everything pending that binds tighter takes the operand on its left,
+    // and so does an equal operator when they associate to the left.
+    while (expr->operators_len > 0) {
+        parser_pending_operator_t* top = &expr->operators[expr->operators_len - 1];
+        if (top->kind == ASTK_GROUP || top->power < op.infix_power
+            || (top->power == op.infix_power && op.associativity == ASSOC_RIGHT)) {
+            break;
+        }
+        PARSER_ReduceOperator(parser, expr);
+    }
 
-    return cast(ast_statement_t*) decl;
+    parser_pending_operator_t* pending = PARSER_PushOperator(expr);
+    pending->token = token;
+    pending->lhs = expr->operand;
+    pending->kind = ASTK_BINARY;
+    pending->power = op.infix_power;
+
+    // Set rather than consumed, so an illegal operand before the operator
+    // cannot hold the cursor back.
+    parser->cursor = token + 1;
+    expr->expect_operand = true;
+    return true;
 }
 
-ast_declaration_t* PARSER_ParseFunction(parser_t* parser, arena_t* scratch)
+bool PARSER_InfixCloseGroup(parser_t* parser, parser_expression_t* expr, uint32 token)
 {
-    // fun [(StructName)] functionName([args...]) -> returnType { [body] }
-    scoped_error_t scoped_error;
-    ast_node_t* fun_keyword = AST_CREATE_NODE(scratch);
-    assert(fun_keyword);
+    if (expr->open_groups == 0) {
+        return false;
+    }
 
-    fun_keyword->kind = ASTK_KEYWORD;
-    fun_keyword->token = parser->current_token;
+    parser_pending_operator_t* top = &expr->operators[expr->operators_len - 1];
+    while (top->kind != ASTK_GROUP) {
+        PARSER_ReduceOperator(parser, expr);
+        top = &expr->operators[expr->operators_len - 1];
+    }
+    PARSER_ReduceOperator(parser, expr);
 
-    // @TODO: Check for possible struct tag after keyword.
+    parser->cursor = token;
+    return true;
+}
 
-    ast_identifier_t* name = AST_CREATE_NODE(scratch);
-    assert(name);
+void PARSER_ReduceOperator(parser_t* parser, parser_expression_t* expr)
+{
+    parser_pending_operator_t op = expr->operators[--expr->operators_len];
+    if (op.kind == ASTK_BINARY) {
+        expr->operand = AST_AddNode(&parser->ast, op.kind, op.token, op.lhs, expr->operand);
+    } else {
+        // Unary operators and groups wrap their only operand in lhs.
+        expr->open_groups -= op.kind == ASTK_GROUP;
+        expr->operand = AST_AddNode(&parser->ast, op.kind, op.token, expr->operand, AST_NONE);
+    }
+}
 
-    name->kind = ASTK_IDENTIFIER;
-    name->token = parser->next_token;
+ast_handle_t PARSER_ParseAssignment(parser_t* parser)
+{
+    // @TODO: specifying types (e.g. var a: uint = 42)
+    // @TODO: Check if `var` is present.
+    uint32 assignment = PARSER_TokenIndex(parser, 1);
+    ast_handle_t name = PARSER_ParseNameWithType(parser, ASTK_IDENTIFIER);
+    PARSER_ConsumeToken(parser); // `:=`
+    PARSER_ConsumeToken(parser); // Onto the expression.
+    ast_handle_t expression = PARSER_ParseExpression(parser, 0);
+    ast_handle_t stmt = AST_AddNode(&parser->ast, ASTK_VARIABLE_ASSIGNMENT, assignment, name, expression);
+
+    if (!parser->panicking && !PARSER_Expect(parser, TK_SEMICOLON)) {
+        stmt = PARSER_AddError(parser, stmt);
+    }
 
-    ast_declaration_t* decl = AST_CREATE_NODE_SIZED(&parser->node_arena, sizeof(ast_declaration_t));
-    decl->kind = ASTK_FUNCTION_DECLARATION;
+    return stmt;
+}
 
-    // @TODO: Make this arena part of some scope node, maybe?
-    // @TODO: Check if this arena is needed, as we already have one created in parse_statement?
-    byte* scope_arena_buffer[4096];
-    arena_t scope_arena;
-    ARENA_Initialize(&scope_arena, scope_arena_buffer, 4096);
+ast_handle_t PARSER_ParseFunction(parser_t* parser)
+{
+    // fun [(StructName)] functionName([args...]) -> returnType { [body] }
+    uint32 fun_keyword = PARSER_TokenIndex(parser, 0);
 
-    // @TODO: Expect parenthesis before consuming the token.
-    // Consume function keyword + name + opening parenthesis.
-    PARSER_ConsumeToken(parser); // `fun`
-    PARSER_ConsumeToken(parser); // functionName @TODO: or struct tag.
-    if (parser->current_token.kind != TK_PARENTHESIS_OPEN) {
-        // @FIXME: Provide some kind of "synchronization" to skip to the next valid token.
-        ERROR_PushScope(&scoped_error, &scope_arena, ERRORK_UNEXPECTED_TOKEN, &parser->current_token);
+    // @TODO: Check for possible struct tag after keyword.
+    if (!PARSER_Expect(parser, TK_IDENTIFIER)) {
+        return PARSER_AddError(parser, AST_NONE);
     }
+    ast_handle_t name = AST_AddNode(&parser->ast, ASTK_IDENTIFIER, parser->cursor, AST_NONE, AST_NONE);
 
-    PARSER_ConsumeToken(parser); // `(`
+    if (!PARSER_Expect(parser, TK_PARENTHESIS_OPEN)) {
+        return PARSER_AddError(parser, name);
+    }
 
-    ast_type_signature_t* signature = AST_CREATE_NODE_SIZED(&scope_arena, sizeof(ast_type_signature_t));
-    if (parser->current_token.kind != TK_PARENTHESIS_CLOSE) {
-        // Parse parameters.
-        uint8 i = 0;
-        while (true) {
-            signature->parameters[i] = PARSER_ParseNameWithType(parser, &scope_arena);
-            // @FIXME: we can set kind in name_with_type directly maybe?
-            signature->parameters[i++]->name->kind = ASTK_FUNCTION_PARAMETER;
+    // Parameters only live until we return, so they go into a scratch arena.
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t parameters;
+    VECTOR_Initialize(&parameters, scratch.arena, sizeof(ast_handle_t));
 
-            if (i == MAX_PARAMETERS) {
-                // @TODO: Throw an error for missing parenthesis...?
-                break;
-            }
+    if (PARSER_PeekKind(parser, 1) == TK_PARENTHESIS_CLOSE) {
+        PARSER_ConsumeToken(parser); // `)`
+    } else {
+        while (PARSER_Expect(parser, TK_IDENTIFIER)) {
+            ast_handle_t parameter = PARSER_ParseNameWithType(parser, ASTK_FUNCTION_PARAMETER);
+            if (parser->panicking) break;
+            *cast(ast_handle_t*) VECTOR_Push(&parameters) = parameter;
 
-            if (parser->current_token.kind == TK_PARENTHESIS_CLOSE) {
+            if (PARSER_PeekKind(parser, 1) == TK_PARENTHESIS_CLOSE) {
                 PARSER_ConsumeToken(parser); // `)`
                 break;
             }
 
-            if (parser->current_token.kind != TK_COMMA) {
-                ERROR_PushScope(&scoped_error, &scope_arena, ERRORK_UNEXPECTED_TOKEN, &parser->current_token);
-            }
-            PARSER_ConsumeToken(parser); // `,`
+            if (!PARSER_Expect(parser, TK_COMMA)) break;
         }
-    } else {
-        PARSER_ConsumeToken(parser); // `)`
     }
 
-    // Consume the return type arrow.
-    PARSER_ConsumeToken(parser); // `->`
+    if (parser->panicking || !PARSER_Expect(parser, TK_THIN_ARROW) || !PARSER_Expect(parser, TK_IDENTIFIER)) {
+        ARENA_ReleaseScratch(scratch);
+        return PARSER_AddError(parser, name);
+    }
 
-    ast_identifier_t* return_type = AST_CREATE_NODE(scratch);
-    return_type->kind = ASTK_FUNCTION_RETURN_TYPE;
-    return_type->token = parser->current_token;
+    ast_function_t function;
+    function.return_type = AST_AddNode(&parser->ast, ASTK_FUNCTION_RETURN_TYPE, parser->cursor, AST_NONE, AST_NONE);
+    function.body = AST_NONE;
+    function.body_open = 0;
+    function.body_close = 0;
+    function.parameters_len = parameters.len;
+    function.depth = parser->depth;
+
+    bool too_deep = false;
+    if (PARSER_PeekKind(parser, 1) == TK_CURLY_BRACE_OPEN) {
+        PARSER_ConsumeToken(parser); // The return type.
+        function.body_open = parser->cursor;
+        function.body_close = PARSER_MatchBrace(parser, function.body_open);
+
+        // The body is skipped as a whole, and the function keeps none.
+        too_deep = parser->depth >= PARSER_MAX_NESTING;
+        if (too_deep) {
+            scoped_error_t error = ERROR_MakeScoped();
+            error.error_kind = ERRORK_NESTED_TOO_DEEP;
+            error.token = TOKEN_FromBuffer(parser->tokens, fun_keyword);
+            ERROR_Report(&error, parser->lexer);
+        } else if (!parser->lazy_bodies) {
+            parser->depth += 1;
+            function.body = PARSER_ParseBlock(parser, function.body_open, function.body_close);
+            parser->depth -= 1;
+        }
 
-    signature->return_type = return_type;
+        // Reported after the body, whose statements recover on their own.
+        if (parser->tokens->kinds[function.body_close] != TK_CURLY_BRACE_CLOSE) {
+            PARSER_ReportError(parser, function.body_close, TK_CURLY_BRACE_CLOSE);
+        }
 
-    decl->function.name = name;
-    decl->function.signature = signature;
-    decl->function.body = NULL; // @TODO: Implement body.
+        // Leave the cursor on the `}`, the last token of the declaration.
+        parser->cursor = function.body_close;
+        if (too_deep) {
+            function.body_open = 0;
+            function.body_close = 0;
+        }
+    }
+
+    // The function record, then its parameters, see ast_function_t.
+    uint32 extra = AST_AddExtra(&parser->ast, cast(uint32*) &function, sizeof(ast_function_t) / sizeof(uint32));
+    uint32 first_parameter = AST_AddExtra(&parser->ast, null, parameters.len);
+    VECTOR_CopyTo(&parameters, parser->ast.extra + first_parameter);
+
+    ast_handle_t decl = AST_AddNode(&parser->ast, ASTK_FUNCTION_DECLARATION, fun_keyword, name, extra);
+    if (too_deep) {
+        decl = AST_AddNode(&parser->ast, ASTK_ERROR, fun_keyword, decl, AST_NONE);
+    }
+    if (parser->panicking) {
+        decl = PARSER_AddError(parser, decl);
+    }
 
-    ERROR_ReportScope(&scoped_error);
+    ARENA_ReleaseScratch(scratch);
     return decl;
 }
 
-ast_name_with_type_t* PARSER_ParseNameWithType(parser_t* parser, arena_t* scratch)
+// Parses the statements between the braces at `open` and `close`, wherever
+// the cursor is, and puts it back afterwards.
+ast_handle_t PARSER_ParseBlock(parser_t* parser, uint32 open, uint32 close)
 {
-    ast_identifier_t* name = AST_CREATE_NODE(scratch);
-    assert(name);
+    TRACE_PRINTF(TRACE_PARSE, TRACE_LEVEL_INFO, "parse: block from token %u to %u\n", open, close);
 
-    name->kind = ASTK_IDENTIFIER;
-    name->token = parser->current_token;
+    uint32 cursor = parser->cursor;
+    parser->cursor = open + 1;
 
-    ast_name_with_type_t* name_with_type = AST_CREATE_NODE_SIZED(scratch, sizeof(ast_name_with_type_t));
-    assert(name_with_type);
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t statements;
+    VECTOR_Initialize(&statements, scratch.arena, sizeof(ast_handle_t));
 
-    name_with_type->name = name;
-    name_with_type->type = NULL;
+    while (parser->cursor < close) {
+        ast_handle_t stmt = PARSER_ParseStatement(parser);
 
-    // Consume the name.
-    // @TODO: Also expect tokens.
-    PARSER_ConsumeToken(parser);
+        if (stmt != AST_NONE) {
+            *cast(ast_handle_t*) VECTOR_Push(&statements) = stmt;
+        }
 
-    // In case the type is specified (after colon), try to set it.
-    if (parser->current_token.kind == TK_COLON) {
         PARSER_ConsumeToken(parser);
+    }
 
-        ast_identifier_t* type = AST_CREATE_NODE(scratch);
-        assert(type);
+    uint32 first = AST_AddExtra(&parser->ast, null, statements.len);
+    VECTOR_CopyTo(&statements, parser->ast.extra + first);
+    ast_handle_t block = AST_AddNode(&parser->ast, ASTK_BLOCK, open, first, statements.len);
+    ARENA_ReleaseScratch(scratch);
 
-        type->kind = ASTK_IDENTIFIER;
-        type->token = parser->current_token;
+    parser->cursor = cursor;
+    return block;
+}
+
+// Expects the cursor on the name, and leaves it on the last token read.
+ast_handle_t PARSER_ParseNameWithType(parser_t* parser, ast_kind_t kind)
+{
+    uint32 name = PARSER_TokenIndex(parser, 0);
+    ast_handle_t type = AST_NONE;
 
+    // In case the type is specified (after colon), try to set it.
+    if (PARSER_PeekKind(parser, 1) == TK_COLON) {
         PARSER_ConsumeToken(parser);
+        if (!PARSER_Expect(parser, TK_IDENTIFIER)) {
+            return PARSER_AddError(parser, AST_AddNode(&parser->ast, kind, name, AST_NONE, AST_NONE));
+        }
 
-        name_with_type->type = type;
+        type = AST_AddNode(&parser->ast, ASTK_IDENTIFIER, parser->cursor, AST_NONE, AST_NONE);
     }
-    return name_with_type;
+
+    return AST_AddNode(&parser->ast, kind, name, type, AST_NONE);
 }
 
-void PARSER_DumpAST(parser_t* parser, ast_program_t* root)
+void PARSER_DumpAST(parser_t* parser)
 {
-    printf("│[Program]\n");
-    for (uint i = 0; i < root->statements_len; ++i) {
-        ast_node_t* node = root->statements[i];
-        printf("└──│[Statement]");
-        AST_DumpNode(node, 1, true);
-        printf("\n");
+    ast_t* ast = &parser->ast;
+    ast_handle_t* statements = ast->extra + ast->lhs[ast->root];
+    uint32 statements_len = ast->rhs[ast->root];
+
+    TRACE_Printf("│[Program]\n");
+    for (uint32 i = 0; i < statements_len; ++i) {
+        PARSER_DumpStatement(parser, statements[i]);
     }
 }
+
+// Prints one top-level statement. The dump reads every body, so the ones a
+// lazy parser skipped are parsed first, in the order they appear in.
+void PARSER_DumpStatement(parser_t* parser, ast_handle_t statement)
+{
+    ast_t* ast = &parser->ast;
+
+    arena_temp_t scratch = ARENA_GetScratch(null, 0);
+    segmented_vector_t pending;
+    VECTOR_Initialize(&pending, scratch.arena, sizeof(ast_handle_t));
+    *cast(ast_handle_t*) VECTOR_Push(&pending) = statement;
+
+    while (pending.len > 0) {
+        ast_handle_t node = *cast(ast_handle_t*) VECTOR_Pop(&pending);
+        switch (ast->kinds[node]) {
+            case ASTK_FUNCTION_DECLARATION: {
+                ast_handle_t body = PARSER_GetFunctionBody(parser, node);
+                if (body != AST_NONE) *cast(ast_handle_t*) VECTOR_Push(&pending) = body;
+                break;
+            }
+            case ASTK_BLOCK: {
+                // Pushed last to first, so that they are popped in order.
+                for (uint32 i = ast->rhs[node]; i > 0; --i) {
+                    *cast(ast_handle_t*) VECTOR_Push(&pending) = ast->extra[ast->lhs[node] + i - 1];
+                }
+                break;
+            }
+            case ASTK_ERROR: {
+                if (ast->lhs[node] != AST_NONE) *cast(ast_handle_t*) VECTOR_Push(&pending) = ast->lhs[node];
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    ARENA_ReleaseScratch(scratch);
+
+    TRACE_Printf("└──│[Statement]");
+    AST_DumpNode(ast, parser->tokens, statement, 1, true);
+    TRACE_Printf("\n");
+}
@@ -22,16 +22,57 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+// Bodies are parsed recursively, so functions nested deeper than this are
+// reported and keep no body, rather than overflowing the stack.
+#define PARSER_MAX_NESTING 64
+
 struct parser
 {
     lexer_t* lexer;
-    arena_t node_arena;
+    ast_t ast;
+
+    token_buffer_t* tokens;
+    uint32 cursor; // Index of the current token.
+
+    // Only record where function bodies are and parse them once something
+    // asks for them, see PARSER_GetFunctionBody().
+    bool lazy_bodies;
 
-    token_t current_token;
-    token_t next_token;
+    // Set by the first error in a statement, which also keeps the ones after
+    // it from being reported, until PARSER_Synchronize() skips past it.
+    bool panicking;
+    uint32 error_token; // The token that started the panic.
+
+    // How many function bodies the cursor is in, see PARSER_MAX_NESTING.
+    uint32 depth;
 };
 typedef struct parser parser_t;
 
+// Files are only split into chunks of at least this many tokens, so small
+// files are parsed serially.
+#define PARSER_MIN_CHUNK_TOKENS (cast(uint32) 1 << 18)
+#define PARSER_MAX_THREADS 64
+
+// One thread's share of PARSER_ParseParallel().
+struct parser_chunk
+{
+    parser_t parser; // Builds an AST of its own.
+    uint32 begin; // Token the chunk's first statement starts at.
+    uint32 end; // Statements starting at or after this are the next chunk's.
+    uint32 stop; // Token the first statement at or after `end` starts at.
+
+    deferred_errors_t errors;
+    arena_t error_arena;
+    bool release_scratch; // Whether it runs on a thread of its own.
+
+    // Where PARSER_MergeChunk() copies the chunk's tree to.
+    ast_t* output;
+    ast_handle_t output_node;
+    uint32 output_extra;
+    uint32 output_statement; // Index in `extra` of its first top-level statement.
+};
+typedef struct parser_chunk parser_chunk_t;
+
 enum operator_associativity_type
 {
     ASSOC_UNKNOWN,
@@ -40,24 +81,86 @@ enum operator_associativity_type
 };
 typedef enum operator_associativity_type operator_associativity_type_t;
 
-parser_t PARSER_Create(lexer_t* lexer);
+// An operator that has been read but not yet built into a node, because its
+// right operand is not complete. Groups stay pending until their `)`.
+struct parser_pending_operator
+{
+    uint32 token;
+    ast_handle_t lhs; // Only for ASTK_BINARY.
+    ast_kind_t kind; // ASTK_BINARY, ASTK_UNARY or ASTK_GROUP.
+    uint8 power;
+};
+typedef struct parser_pending_operator parser_pending_operator_t;
+
+// State of the expression being parsed. It lives on an explicit stack rather
+// than the call stack, so neither nesting nor chain length recurse.
+struct parser_expression
+{
+    // A plain array rather than a segmented vector: it is popped and peeked
+    // at for every operator, and growing it is rare and cheap at the top of
+    // the scratch arena.
+    arena_t* arena;
+    parser_pending_operator_t* operators;
+    uint32 operators_len;
+    uint32 operators_cap;
+    ast_handle_t operand; // The last operand, or the operators reduced into it.
+    uint32 open_groups;
+    uint8 min_power; // Infix operators binding at most this tight end the expression.
+    bool expect_operand;
+};
+typedef struct parser_expression parser_expression_t;
+
+// Called with the index of the operator token. Prefix handlers run where an
+// operand was expected; infix handlers run after an operand and return false
+// when the token does not continue the expression.
+typedef void (*parser_prefix_fn_t)(parser_t* parser, parser_expression_t* expr, uint32 token);
+typedef bool (*parser_infix_fn_t)(parser_t* parser, parser_expression_t* expr, uint32 token);
+
+struct parser_operator
+{
+    parser_prefix_fn_t prefix;
+    parser_infix_fn_t infix;
+    uint8 prefix_power;
+    uint8 infix_power;
+    operator_associativity_type_t associativity;
+};
+typedef struct parser_operator parser_operator_t;
+
+parser_t PARSER_Create(lexer_t* lexer, token_buffer_t* tokens);
 void PARSER_Destroy(parser_t* parser);
 void PARSER_ConsumeToken(parser_t* parser);
+uint32 PARSER_TokenIndex(parser_t* parser, uint32 ahead);
+token_kind_t PARSER_PeekKind(parser_t* parser, uint32 ahead);
+number_t PARSER_PeekNumber(parser_t* parser, uint32 ahead);
+bool PARSER_Expect(parser_t* parser, token_kind_t kind);
+void PARSER_ReportError(parser_t* parser, uint32 token, token_kind_t expected);
+ast_handle_t PARSER_AddError(parser_t* parser, ast_handle_t partial);
+void PARSER_Synchronize(parser_t* parser, uint32 start);
 void PARSER_Parse(parser_t* parser);
+void PARSER_ParseParallel(parser_t* parser, uint thread_count);
+void PARSER_ParseChunk(void* chunk);
+void PARSER_MergeChunk(void* chunk);
+void PARSER_ParseTopLevel(parser_t* parser, uint32 end, segmented_vector_t* statements);
+void PARSER_FinishProgram(parser_t* parser, segmented_vector_t* statements);
+uint32 PARSER_MatchBrace(parser_t* parser, uint32 open);
+ast_handle_t PARSER_GetFunctionBody(parser_t* parser, ast_handle_t function);
 
-/* Helpers */
-bool PARSER_TokenKindIsOperator(token_kind_t kind);
-uint PARSER_OperatorPrecedence(token_kind_t op);
-operator_associativity_type_t PARSER_OperatorAssociativity(token_kind_t op);
+/* Expression handlers, see parser_operators */
+void PARSER_PrefixUnary(parser_t* parser, parser_expression_t* expr, uint32 token);
+void PARSER_PrefixGroup(parser_t* parser, parser_expression_t* expr, uint32 token);
+bool PARSER_InfixBinary(parser_t* parser, parser_expression_t* expr, uint32 token);
+bool PARSER_InfixCloseGroup(parser_t* parser, parser_expression_t* expr, uint32 token);
+void PARSER_ReduceOperator(parser_t* parser, parser_expression_t* expr);
 
 /* Parsing functions */
-ast_statement_t* PARSER_ParseStatement(parser_t* parser);
-ast_expression_t* PARSER_ParseExpression(parser_t* parser, uint8 prec_limit, arena_t* scratch);
-ast_statement_t* PARSER_ParseIdentifier(parser_t* parser);
-ast_statement_t* PARSER_ParseAssignment(parser_t* parser, arena_t* scratch);
-ast_declaration_t* PARSER_ParseFunction(parser_t* parser, arena_t* scratch);
-ast_name_with_type_t* PARSER_ParseNameWithType(parser_t* parser, arena_t* scratch);
-
-void PARSER_DumpAST(parser_t* parser, ast_program_t* root);
+ast_handle_t PARSER_ParseStatement(parser_t* parser);
+ast_handle_t PARSER_ParseExpression(parser_t* parser, uint8 min_power);
+ast_handle_t PARSER_ParseAssignment(parser_t* parser);
+ast_handle_t PARSER_ParseFunction(parser_t* parser);
+ast_handle_t PARSER_ParseBlock(parser_t* parser, uint32 open, uint32 close);
+ast_handle_t PARSER_ParseNameWithType(parser_t* parser, ast_kind_t kind);
+
+void PARSER_DumpAST(parser_t* parser);
+void PARSER_DumpStatement(parser_t* parser, ast_handle_t statement);
 
 #endif // PARSE_H
@@ -0,0 +1,60 @@
+#!/bin/sh
+
+# Replays edit sessions with --edits, and checks that they print the same
+# tokens, tree and errors as parsing the final text from scratch. Also checks
+# that compaction keeps the tree from growing with the number of edits.
+#
+# Usage: tests/edits.sh <lang binary built with TRACE_ENABLED>
+
+LANG_BIN=$1
+TESTS=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+# replay <source> <session> [flags...]
+replay()
+{
+    SOURCE=$1
+    SESSION=$2
+    shift 2
+    "$LANG_BIN" "$@" --dump-tokens --dump-ast --edits "$SESSION" "$SOURCE" > "$TMP/edited.out" 2> "$TMP/edited.err"
+    "$LANG_BIN" "$@" --dump-tokens --dump-ast --full-reparse --edits "$SESSION" "$SOURCE" > "$TMP/full.out" 2> "$TMP/full.err"
+    if cmp -s "$TMP/edited.out" "$TMP/full.out" && cmp -s "$TMP/edited.err" "$TMP/full.err"; then
+        echo "ok:   $SESSION $*"
+    else
+        echo "FAIL: $SESSION $*"
+        diff "$TMP/full.err" "$TMP/edited.err" | head -n 10
+        diff "$TMP/full.out" "$TMP/edited.out" | head -n 10
+        FAILED=1
+    fi
+}
+
+for FLAGS in "" "--lazy-bodies"; do
+    replay "$TESTS/edits/sample.l" "$TESTS/edits/sample.edits" $FLAGS
+    for SEED in 2 3 4 5; do
+        python3 "$TESTS/gen_edits.py" "$TESTS/edits/sample.l" 500 "$TMP/session$SEED.edits" $SEED || exit 1
+        replay "$TESTS/edits/sample.l" "$TMP/session$SEED.edits" $FLAGS
+    done
+done
+
+# Compaction runs once dead nodes outnumber live ones, so there are never
+# more than twice as many nodes as the statements use. It also drops the
+# symbols no identifier in the text uses anymore.
+python3 "$TESTS/gen_edits.py" "$TESTS/edits/sample.l" 20000 "$TMP/long.edits" 6 || exit 1
+STATS=$("$LANG_BIN" --mem-stats --edits "$TMP/long.edits" "$TESTS/edits/sample.l" 2>&1 | grep '^document:')
+NODES=$(echo "$STATS" | sed 's/.* \([0-9]*\) nodes.*/\1/')
+LIVE=$(echo "$STATS" | sed 's/.*(\([0-9]*\) live).*/\1/')
+SYMBOLS=$(echo "$STATS" | sed 's/.* \([0-9]*\) symbols.*/\1/')
+COMPACTIONS=$(echo "$STATS" | sed 's/.* \([0-9]*\) compactions.*/\1/')
+IDENTIFIERS=$("$LANG_BIN" --full-reparse --dump-tokens --edits "$TMP/long.edits" "$TESTS/edits/sample.l" 2> /dev/null \
+    | grep 'an identifier' | sort -u | wc -l)
+if [ -n "$NODES" ] && [ "$NODES" -le $((2 * LIVE)) ] && [ "$COMPACTIONS" -gt 0 ] \
+    && [ "$SYMBOLS" -le $((2 * IDENTIFIERS)) ]; then
+    echo "ok:   20000 edits, $STATS, $IDENTIFIERS distinct identifiers"
+else
+    echo "FAIL: 20000 edits, $STATS, $IDENTIFIERS distinct identifiers"
+    FAILED=1
+fi
+
+exit $FAILED
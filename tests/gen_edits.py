@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Writes a random edit session for a source file, in the format --edits reads:
+# a line with the start and end of the bytes an edit replaces and the length
+# of its text, then the text and a newline.
+#
+# usage: gen_edits.py <source> <edits> <output> [seed]
+#
+# Most edits type a statement into the file one keystroke at a time, and
+# maybe take it back the same way. The rest rename identifiers, paste and
+# delete whole functions, and type the braces, quotes and keywords that
+# change how much of the file a statement covers.
+
+import random
+import re
+import sys
+
+source = open(sys.argv[1], 'rb').read()
+count = int(sys.argv[2])
+out = open(sys.argv[3], 'wb')
+random.seed(int(sys.argv[4]) if len(sys.argv) > 4 else 1)
+
+pieces = [b'{', b'}', b'(', b')', b';', b'"', b'fun ', b' := ', b'123', b'99999999999999999999999',
+          b'\n', b' ', b'x', b'a + b', b'fun f(a: int) -> int {', b'-> int', b'1.5', b'\t', b'var',
+          b'}\n', b'q := 1;\n']
+identifier = re.compile(rb'[a-z][a-z0-9]*')
+text = source
+edits = 0
+
+def emit(start, end, replacement):
+    global text, edits
+    out.write(b'%d %d %d\n' % (start, end, len(replacement)) + replacement + b'\n')
+    text = text[:start] + replacement + text[end:]
+    edits += 1
+
+while edits < count:
+    kind = random.random()
+    if kind < 0.5:
+        at = text.find(b';', random.randrange(len(text) + 1))
+        if at < 0: at = len(text) - 1 if text else -1
+        at += 1
+        statement = b' v%d := a * %d + b;' % (random.randrange(100), random.randrange(1000))
+        for i in range(len(statement)):
+            emit(at + i, at + i, statement[i:i + 1])
+        if random.random() < 0.5:
+            for i in range(len(statement), 0, -1):
+                emit(at + i - 1, at + i, b'')
+    elif kind < 0.6:
+        match = identifier.search(text, random.randrange(len(text) + 1))
+        if match: emit(match.start(), match.end(), b'n%d' % random.randrange(10**6))
+    elif kind < 0.7:
+        at = text.find(b'\nfun ', random.randrange(len(text) + 1))
+        if at < 0: continue
+        end = text.find(b'\nfun ', at + 1)
+        if random.random() < 0.5 and end > 0:
+            emit(at + 1, end + 1, b'')
+        else:
+            emit(at + 1, at + 1, b'fun p%d(a: int, b: int) -> int { c := a + b; d := c * 2; }\n' % random.randrange(10**6))
+    elif kind < 0.85:
+        at = random.randint(0, len(text))
+        emit(at, at, b''.join(random.choice(pieces) for _ in range(random.randint(1, 3))))
+    else:
+        start = random.randint(0, len(text))
+        emit(start, min(len(text), start + random.randint(1, 8)), b'')
+
+out.close()
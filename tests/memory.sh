@@ -0,0 +1,48 @@
+#!/bin/sh
+
+# Runs under a limited address space (ulimit -v), where arenas cannot reserve
+# ARENA_DEFAULT_RESERVE each. Small inputs have to parse as usual, and inputs
+# too big for the limit have to fail with an error rather than crash.
+#
+# Usage: tests/memory.sh <lang binary>
+
+LANG_BIN=$1
+TESTS=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+echo 'x := 1;' > "$TMP/one.l"
+awk 'BEGIN { for (i = 0; i < 200000; ++i) printf "x%d := %d + y * (z - %d);\n", i, i, i % 7 }' > "$TMP/big.l"
+
+# Expects `status` from running the rest of the arguments with `limit` KB of
+# address space.
+check() {
+    LIMIT=$1
+    EXPECTED=$2
+    shift 2
+    (ulimit -v "$LIMIT" && "$LANG_BIN" "$@" > /dev/null 2> "$TMP/stderr")
+    STATUS=$?
+    if [ $STATUS = "$EXPECTED" ]; then
+        echo "ok:   $* under $LIMIT KB"
+    else
+        echo "FAIL: $* under $LIMIT KB exited with $STATUS rather than $EXPECTED"
+        head -n 5 "$TMP/stderr"
+        FAILED=1
+    fi
+}
+
+check 8000000 0 "$TMP/one.l"
+check 8000000 0 --threads 4 "$TMP/one.l"
+# The sample session ends with syntax errors, hence 1.
+check 8000000 1 --edits "$TESTS/edits/sample.edits" "$TESTS/edits/sample.l"
+check 8000000 0 "$TMP/big.l"
+check 8000000 0 --threads 4 "$TMP/big.l"
+check 200000 1 "$TMP/big.l"
+check 200000 1 --threads 4 "$TMP/big.l"
+if ! grep -q "ran out of memory" "$TMP/stderr"; then
+    echo "FAIL: running out of memory was not reported"
+    FAILED=1
+fi
+
+exit $FAILED
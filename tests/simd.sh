@@ -0,0 +1,48 @@
+#!/bin/sh
+
+# Lexes a corpus with the vector kernels and with --no-simd, and checks that
+# both print the same tokens and errors.
+#
+# Usage: tests/simd.sh <lang binary built with TRACE_ENABLED>
+
+LANG_BIN=$1
+TESTS=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+# Runs of every kind of token, from shorter to longer than a vector, and the
+# bytes around them that end a run.
+awk 'BEGIN {
+    for (n = 1; n <= 80; ++n) {
+        run = ""; digits = ""; spaces = ""; tabs = "";
+        for (i = 0; i < n; ++i) {
+            run = run substr("abcdefghijklmnopqrstuvwxyz_0123456789", i % 37 + 1, 1);
+            digits = digits (i % 10); spaces = spaces " "; tabs = tabs "\t";
+        }
+        printf "x%s := %s.%s +%s%s;\n", run, digits, digits, spaces, run;
+        printf "%s%s%s(%s)%s{%s}\r\n", spaces, run, tabs, digits, spaces, digits;
+        printf "fun f%s(a: %s) -> %s { %s := 1%s; }\n", n, run, run, run, digits;
+        printf "%s@%s#%s$%s\n", run, digits, run, spaces;
+    }
+}' > "$TMP/runs.l"
+
+# Files that end in the middle of a run, at every offset into the padding.
+for N in $(seq 1 130); do
+    head -c "$N" "$TMP/runs.l" > "$TMP/end$N.l"
+    printf '%*s' "$N" '' | tr ' ' 'z' > "$TMP/ident$N.l"
+    printf '%*s' "$N" '' | tr ' ' '7' > "$TMP/digits$N.l"
+done
+
+for FILE in "$TESTS"/edits/*.l "$TESTS"/../main.c "$TESTS"/../src/*.c "$TESTS"/../base/*.c "$TMP"/*.l; do
+    "$LANG_BIN" --dump-tokens "$FILE" > "$TMP/simd.out" 2>&1
+    "$LANG_BIN" --dump-tokens --no-simd "$FILE" > "$TMP/scalar.out" 2>&1
+    if ! cmp -s "$TMP/simd.out" "$TMP/scalar.out"; then
+        echo "FAIL: $FILE"
+        diff "$TMP/scalar.out" "$TMP/simd.out" | head -n 10
+        FAILED=1
+    fi
+done
+
+[ $FAILED = 0 ] && echo "ok:   every file lexes the same with and without --no-simd"
+exit $FAILED
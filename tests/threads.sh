@@ -0,0 +1,68 @@
+#!/bin/sh
+
+# Lexes and parses files big enough to be split between threads with
+# --threads 1 and with more threads, and checks that they print the same
+# tokens, tree and errors. Then runs --threads 4 under ThreadSanitizer.
+#
+# Usage: tests/threads.sh <lang binary built with TRACE_ENABLED>
+
+LANG_BIN=$1
+TESTS=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+# Both are over 4 MB and 2^20 tokens, so that the lexer and the parser split
+# them in 4 chunks of at least LEXER_MIN_CHUNK_SIZE (1 MB) and
+# PARSER_MIN_CHUNK_TOKENS (2^18 tokens).
+yes 'fun f(a: int, b: int) -> int { c := a + b * 2; d := (c - 1) ^ 2; }' | head -n 70000 > "$TMP/clean.l"
+yes "$(printf '%s\n' \
+    'a := 1 + ;' \
+    'fun g(a: int, b: ) -> int { z := $ + 1; w := 2; }' \
+    'n := 99999999999999999999999 * "text";' \
+    'fun h() -> int { fun i() -> int { t := 1 }' \
+    '} } c := 4 5;' \
+    'x := 1.5 @ # y;')" | head -n 150000 > "$TMP/junk.l"
+
+for FLAGS in "" "--lazy-bodies"; do
+    for FILE in "$TMP/clean.l" "$TMP/junk.l"; do
+        "$LANG_BIN" $FLAGS --threads 1 --dump-tokens --dump-ast "$FILE" > "$TMP/serial.out" 2>&1
+        for THREADS in 2 3 4; do
+            "$LANG_BIN" $FLAGS --threads $THREADS --dump-tokens --dump-ast "$FILE" > "$TMP/parallel.out" 2>&1
+            if cmp -s "$TMP/serial.out" "$TMP/parallel.out"; then
+                echo "ok:   $(basename "$FILE") --threads $THREADS $FLAGS"
+            else
+                echo "FAIL: $(basename "$FILE") --threads $THREADS $FLAGS"
+                diff "$TMP/serial.out" "$TMP/parallel.out" | head -n 10
+                FAILED=1
+            fi
+        done
+    done
+done
+
+# Worker threads must not race with each other or the calling thread, e.g. on
+# kernels that are resolved lazily. Long identifiers and numbers too long for
+# the fast path reach the string kernels and the scratch arenas on every
+# thread. Built here, since ThreadSanitizer needs a build of its own.
+if gcc -I"$TESTS/../src" -O1 -g -std=c99 -w -fsanitize=thread "$TESTS/../main.c" -o "$TMP/lang_tsan" -pthread -lm 2> /dev/null; then
+    awk 'BEGIN {
+        for (i = 0; i < 80000; ++i) {
+            printf "a_rather_long_identifier_name_%d := another_long_identifier_%d + 12.5;\n", i, i
+            if (i % 1000 == 0) printf "n%d := 3.14159265358979323846264338327950288;\n", i
+        }
+    }' > "$TMP/tsan.l"
+    for FLAGS in "" "--lazy-bodies"; do
+        TSAN_OPTIONS="exitcode=66" "$TMP/lang_tsan" $FLAGS --threads 4 "$TMP/tsan.l" > /dev/null 2> "$TMP/tsan.out"
+        if [ $? != 66 ] && ! grep -q ThreadSanitizer "$TMP/tsan.out"; then
+            echo "ok:   tsan.l --threads 4 $FLAGS under ThreadSanitizer"
+        else
+            echo "FAIL: tsan.l --threads 4 $FLAGS under ThreadSanitizer"
+            grep -A 12 "WARNING" "$TMP/tsan.out" | head -n 30
+            FAILED=1
+        fi
+    done
+else
+    echo "skip: this compiler cannot build with -fsanitize=thread"
+fi
+
+exit $FAILED